@@ -0,0 +1,151 @@
+/**
+ * @file parserBench.cpp
+ * @brief Micro-benchmark of the text .3d parser against the previous istringstream parser
+ *
+ * Usage: parser_bench [iterations] [file.3d ...]
+ * Without files it benchmarks tests/bezier_10.3d and tests/box_2.5_30.3d
+ * (run from the build directory, like the engine).
+ */
+
+#include "modelLoader.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+/**
+ * @brief The parser loadModel used before readTextModel
+ *
+ * Kept here unchanged (apart from logging) as the baseline: every line goes
+ * through an istringstream and is re-parsed for each candidate layout.
+ */
+bool legacyReadTextModel(const std::string& filename,
+                         std::vector<Point>& vertices,
+                         std::vector<Point>& normals,
+                         std::vector<float>& texCoords) {
+    std::ifstream file(filename);
+    if (!file.is_open()) return false;
+
+    std::vector<Point> tmpVertices;
+    std::vector<Point> tmpNormals;
+    std::vector<float> tmpTexCoords;
+
+    std::string line;
+    while (std::getline(file, line)) {
+        std::istringstream iss(line);
+        Point vertex, normal;
+        float u, v;
+
+        if (iss >> vertex.x >> vertex.y >> vertex.z >> normal.x >> normal.y >> normal.z >> u >> v) {
+            tmpVertices.push_back(vertex);
+            tmpNormals.push_back(normal);
+            tmpTexCoords.push_back(u);
+            tmpTexCoords.push_back(v);
+        } else {
+            iss.clear();
+            iss.str(line);
+            if (iss >> vertex.x >> vertex.y >> vertex.z >> u >> v) {
+                tmpVertices.push_back(vertex);
+                tmpTexCoords.push_back(u);
+                tmpTexCoords.push_back(v);
+            } else {
+                iss.clear();
+                iss.str(line);
+                if (iss >> vertex.x >> vertex.y >> vertex.z) {
+                    tmpVertices.push_back(vertex);
+                }
+            }
+        }
+    }
+
+    // The old loader copied the temporaries into the Model
+    vertices = tmpVertices;
+    normals = tmpNormals;
+    texCoords = tmpTexCoords;
+    return true;
+}
+
+typedef bool (*ParserFunc)(const std::string&, std::vector<Point>&, std::vector<Point>&, std::vector<float>&);
+
+struct Timing {
+    double best;
+    double mean;
+};
+
+// Runs a parser several times and returns best/mean wall time in milliseconds
+Timing timeParser(ParserFunc parser, const std::string& filename, int iterations) {
+    std::vector<Point> vertices, normals;
+    std::vector<float> texCoords;
+    Timing timing = {1e30, 0.0};
+    for (int i = 0; i < iterations; i++) {
+        auto start = std::chrono::steady_clock::now();
+        parser(filename, vertices, normals, texCoords);
+        auto stop = std::chrono::steady_clock::now();
+        double ms = std::chrono::duration<double, std::milli>(stop - start).count();
+        timing.best = std::min(timing.best, ms);
+        timing.mean += ms / iterations;
+    }
+    return timing;
+}
+
+// Largest absolute difference between two float arrays (or infinity if sizes differ)
+double maxDifference(const float* a, size_t aCount, const float* b, size_t bCount) {
+    if (aCount != bCount) return INFINITY;
+    double diff = 0.0;
+    for (size_t i = 0; i < aCount; i++) {
+        diff = std::max(diff, static_cast<double>(std::fabs(a[i] - b[i])));
+    }
+    return diff;
+}
+
+int main(int argc, char** argv) {
+    int iterations = 20;
+    std::vector<std::string> files;
+    for (int i = 1; i < argc; i++) {
+        char* end = nullptr;
+        long value = std::strtol(argv[i], &end, 10);
+        if (*end == '\0' && value > 0) iterations = static_cast<int>(value);
+        else files.push_back(argv[i]);
+    }
+    if (files.empty()) {
+        files.push_back("../tests/bezier_10.3d");
+        files.push_back("../tests/box_2.5_30.3d");
+    }
+
+    std::printf("%-28s %10s %12s %12s %12s %12s %8s\n",
+                "file", "vertices", "legacy best", "legacy mean", "new best", "new mean", "speedup");
+    for (const std::string& filename : files) {
+        std::vector<Point> oldVertices, oldNormals, newVertices, newNormals;
+        std::vector<float> oldTexCoords, newTexCoords;
+        if (!legacyReadTextModel(filename, oldVertices, oldNormals, oldTexCoords) ||
+            !readTextModel(filename, newVertices, newNormals, newTexCoords)) {
+            std::fprintf(stderr, "Cannot read %s\n", filename.c_str());
+            return 1;
+        }
+
+        // Both parsers must produce the same geometry
+        double diff = std::max(std::max(
+            maxDifference(&oldVertices[0].x, oldVertices.size() * 3, &newVertices[0].x, newVertices.size() * 3),
+            maxDifference(oldNormals.empty() ? nullptr : &oldNormals[0].x, oldNormals.size() * 3,
+                          newNormals.empty() ? nullptr : &newNormals[0].x, newNormals.size() * 3)),
+            maxDifference(oldTexCoords.data(), oldTexCoords.size(), newTexCoords.data(), newTexCoords.size()));
+        if (diff > 1e-6) {
+            std::fprintf(stderr, "Parsers disagree on %s (max difference %g)\n", filename.c_str(), diff);
+            return 1;
+        }
+
+        Timing legacy = timeParser(legacyReadTextModel, filename, iterations);
+        Timing fast = timeParser(readTextModel, filename, iterations);
+        size_t slash = filename.find_last_of("/\\");
+        std::string name = (slash == std::string::npos) ? filename : filename.substr(slash + 1);
+        std::printf("%-28s %10zu %9.2f ms %9.2f ms %9.2f ms %9.2f ms %7.1fx\n",
+                    name.c_str(), newVertices.size(), legacy.best, legacy.mean,
+                    fast.best, fast.mean, legacy.best / fast.best);
+    }
+    return 0;
+}
@@ -0,0 +1,328 @@
+#ifndef MESH_FORMAT_H
+#define MESH_FORMAT_H
+
+/**
+ * @file meshFormat.h
+ * @brief Binary .3db mesh container shared by the generator and the engine
+ *
+ * The text .3d format stores one vertex per line and has to be re-parsed on
+ * every engine start. The .3db container stores the same data as raw
+ * little-endian floats so it can be read with one bulk read per attribute.
+ *
+ * File layout:
+ *   MeshFileHeader                          (44 bytes)
+ *   positions  vertexCount * 3 floats       (always present)
+ *   normals    vertexCount * 3 floats       (if MESH_ATTRIB_NORMAL)
+ *   texCoords  vertexCount * 2 floats       (if MESH_ATTRIB_TEXCOORD)
+ *   indices    indexCount uint32            (if indexCount > 0)
+ *
+ * Without indices the vertices form a triangle list (3 per triangle); with
+ * indices every 3 indices form a triangle over the unique vertices.
+ *
+ * Quantized files (MESH_ATTRIB_QUANTIZED, which requires all three
+ * attributes) replace the three attribute blocks with one interleaved
+ * block of 16-byte vertices that the GPU decodes directly:
+ *   int16  position[3]   snorm steps around the bounding box centre (see MeshPositionQuantization)
+ *   int16  padding       0
+ *   uint32 normal        10:10:10:2 signed normalized, x in the low bits
+ *   uint16 texCoord[2]   half floats
+ *
+ * A file may hold a level-of-detail chain: further complete meshes
+ * (header and blocks, each coarser than the one before) follow the first
+ * one, up to MESH_MAX_LOD_LEVELS in all. Every block size is a multiple of
+ * 4 bytes, so each level stays aligned. Readers that only want one mesh
+ * read the first and ignore the rest.
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+// "3DB\0" at the start of every binary mesh file
+const char MESH_FILE_MAGIC[4] = {'3', 'D', 'B', '\0'};
+const uint32_t MESH_FILE_VERSION = 3;
+
+// Oldest version that can still be read (version 2 files are never quantized)
+const uint32_t MESH_FILE_MIN_VERSION = 2;
+
+// Bits of MeshFileHeader::attribMask
+const uint32_t MESH_ATTRIB_POSITION  = 1u << 0;
+const uint32_t MESH_ATTRIB_NORMAL    = 1u << 1;
+const uint32_t MESH_ATTRIB_TEXCOORD  = 1u << 2;
+const uint32_t MESH_ATTRIB_QUANTIZED = 1u << 3;
+const uint32_t MESH_ATTRIB_ALL = MESH_ATTRIB_POSITION | MESH_ATTRIB_NORMAL | MESH_ATTRIB_TEXCOORD |
+                                 MESH_ATTRIB_QUANTIZED;
+
+// Size of one vertex in a quantized file
+const size_t MESH_QUANTIZED_VERTEX_SIZE = 16;
+
+// Most levels a level-of-detail chain may hold (including the first mesh)
+const unsigned MESH_MAX_LOD_LEVELS = 8;
+
+// Fixed-size header at the start of a .3db file (all fields little-endian)
+struct MeshFileHeader {
+    char magic[4];          // MESH_FILE_MAGIC
+    uint32_t version;       // MESH_FILE_VERSION
+    uint32_t vertexCount;   // Number of vertices (3 per triangle when not indexed)
+    uint32_t attribMask;    // MESH_ATTRIB_* bits present in the file
+    uint32_t indexCount;    // Number of indices (0 = not indexed)
+    float boundsMin[3];     // Axis-aligned bounding box of the positions
+    float boundsMax[3];
+};
+
+static_assert(sizeof(MeshFileHeader) == 44, "MeshFileHeader must be tightly packed");
+static_assert(sizeof(float) == 4, "The .3db format stores 32-bit floats");
+
+// Returns true when the host stores multi-byte values little-endian
+inline bool isLittleEndianHost() {
+    const uint32_t probe = 1;
+    unsigned char first;
+    std::memcpy(&first, &probe, 1);
+    return first == 1;
+}
+
+// Byte-swaps an array of 32-bit words in place (used on big-endian hosts only)
+inline void swapWords(void* data, size_t count) {
+    unsigned char* bytes = static_cast<unsigned char*>(data);
+    for (size_t i = 0; i < count; i++, bytes += 4) {
+        unsigned char t0 = bytes[0], t1 = bytes[1];
+        bytes[0] = bytes[3];
+        bytes[1] = bytes[2];
+        bytes[2] = t1;
+        bytes[3] = t0;
+    }
+}
+
+// Converts every field after the magic between file and host byte order
+inline void swapMeshHeader(MeshFileHeader& header) {
+    swapWords(&header.version, (sizeof(MeshFileHeader) - sizeof(header.magic)) / 4);
+}
+
+// Checks whether a buffer starts with the .3db magic number
+inline bool isMeshFileMagic(const void* data, size_t size) {
+    return size >= sizeof(MESH_FILE_MAGIC) &&
+           std::memcmp(data, MESH_FILE_MAGIC, sizeof(MESH_FILE_MAGIC)) == 0;
+}
+
+// Number of floats stored per vertex for an attribute mask
+inline size_t meshFloatsPerVertex(uint32_t attribMask) {
+    size_t floats = 3;
+    if (attribMask & MESH_ATTRIB_NORMAL) floats += 3;
+    if (attribMask & MESH_ATTRIB_TEXCOORD) floats += 2;
+    return floats;
+}
+
+// Bytes stored per vertex for an attribute mask
+inline size_t meshVertexSize(uint32_t attribMask) {
+    if (attribMask & MESH_ATTRIB_QUANTIZED) return MESH_QUANTIZED_VERTEX_SIZE;
+    return meshFloatsPerVertex(attribMask) * sizeof(float);
+}
+
+// Checks that an attribute mask has positions, no unknown bits, and all
+// three attributes when quantized
+inline bool isValidMeshAttribMask(uint32_t attribMask) {
+    if (!(attribMask & MESH_ATTRIB_POSITION) || (attribMask & ~MESH_ATTRIB_ALL)) return false;
+    return !(attribMask & MESH_ATTRIB_QUANTIZED) ||
+           (attribMask & (MESH_ATTRIB_NORMAL | MESH_ATTRIB_TEXCOORD)) == (MESH_ATTRIB_NORMAL | MESH_ATTRIB_TEXCOORD);
+}
+
+// Byte offset of an attribute block from the start of the file (unquantized files only)
+inline size_t meshAttribOffset(const MeshFileHeader& header, uint32_t attrib) {
+    size_t offset = sizeof(MeshFileHeader);
+    size_t count = header.vertexCount;
+    if (attrib == MESH_ATTRIB_POSITION) return offset;
+    offset += count * 3 * sizeof(float);
+    if (attrib == MESH_ATTRIB_NORMAL) return offset;
+    if (header.attribMask & MESH_ATTRIB_NORMAL) offset += count * 3 * sizeof(float);
+    return offset;
+}
+
+// Byte offset of the index block from the start of the file
+inline size_t meshIndexOffset(const MeshFileHeader& header) {
+    return sizeof(MeshFileHeader) + static_cast<size_t>(header.vertexCount) * meshVertexSize(header.attribMask);
+}
+
+// Expected total file size for a header, used to reject truncated files
+inline size_t meshFileSize(const MeshFileHeader& header) {
+    return meshIndexOffset(header) + static_cast<size_t>(header.indexCount) * sizeof(uint32_t);
+}
+
+// Offset of the level following the mesh at offset in a LOD chain, or 0 if it is the last
+inline size_t meshNextLevelOffset(const char* data, size_t size, size_t offset, const MeshFileHeader& header) {
+    size_t next = offset + meshFileSize(header);
+    if (next >= size || size - next < sizeof(MeshFileHeader) || !isMeshFileMagic(data + next, size - next)) {
+        return 0;
+    }
+    return next;
+}
+
+// Checks that every index refers to an existing vertex
+inline bool meshIndicesInRange(const uint32_t* indices, size_t indexCount, uint32_t vertexCount) {
+    for (size_t i = 0; i < indexCount; i++) {
+        if (indices[i] >= vertexCount) return false;
+    }
+    return true;
+}
+
+//-- QUANTIZED VERTICES --
+
+// Positions of a quantized file are center + q * scale, with q in [-32767, 32767]
+struct MeshPositionQuantization {
+    float center[3];
+    float scale;    // Same on every axis, so the dequantization keeps normals undistorted
+};
+
+// Quantization grid of a file, derived from its bounding box
+inline MeshPositionQuantization meshPositionQuantization(const MeshFileHeader& header) {
+    MeshPositionQuantization q;
+    float halfExtent = 0;
+    for (int k = 0; k < 3; k++) {
+        q.center[k] = (header.boundsMin[k] + header.boundsMax[k]) * 0.5f;
+        float half = (header.boundsMax[k] - header.boundsMin[k]) * 0.5f;
+        if (half > halfExtent) halfExtent = half;
+    }
+    q.scale = halfExtent > 0 ? halfExtent / 32767.0f : 1.0f;
+    return q;
+}
+
+// Little-endian stores and loads, independent of the host byte order
+inline void storeLE16(unsigned char* out, uint16_t value) {
+    out[0] = static_cast<unsigned char>(value);
+    out[1] = static_cast<unsigned char>(value >> 8);
+}
+
+inline void storeLE32(unsigned char* out, uint32_t value) {
+    storeLE16(out, static_cast<uint16_t>(value));
+    storeLE16(out + 2, static_cast<uint16_t>(value >> 16));
+}
+
+inline uint16_t loadLE16(const unsigned char* in) {
+    return static_cast<uint16_t>(in[0] | (in[1] << 8));
+}
+
+inline uint32_t loadLE32(const unsigned char* in) {
+    return loadLE16(in) | (static_cast<uint32_t>(loadLE16(in + 2)) << 16);
+}
+
+// Converts a float to IEEE half precision (round to nearest even)
+inline uint16_t floatToHalf(float value) {
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    uint32_t sign = (bits >> 16) & 0x8000u;
+    uint32_t floatExponent = (bits >> 23) & 0xffu;
+    uint32_t mantissa = bits & 0x7fffffu;
+
+    if (floatExponent == 0xffu) {
+        return static_cast<uint16_t>(sign | 0x7c00u | (mantissa ? 0x200u : 0u));  // Inf / NaN
+    }
+    int exponent = static_cast<int>(floatExponent) - 127 + 15;
+    if (exponent >= 31) {
+        return static_cast<uint16_t>(sign | 0x7c00u);  // Overflow to infinity
+    }
+
+    uint32_t half, rest, halfway;
+    if (exponent <= 0) {
+        // Subnormal half (or zero)
+        if (exponent < -10) return static_cast<uint16_t>(sign);
+        mantissa |= 0x800000u;
+        uint32_t shift = static_cast<uint32_t>(14 - exponent);
+        half = mantissa >> shift;
+        rest = mantissa & ((1u << shift) - 1);
+        halfway = 1u << (shift - 1);
+    } else {
+        half = (static_cast<uint32_t>(exponent) << 10) | (mantissa >> 13);
+        rest = mantissa & 0x1fffu;
+        halfway = 0x1000u;
+    }
+    // A carry out of the mantissa correctly bumps the exponent
+    if (rest > halfway || (rest == halfway && (half & 1u))) half++;
+    return static_cast<uint16_t>(sign | half);
+}
+
+// Converts an IEEE half precision value to float
+inline float halfToFloat(uint16_t half) {
+    uint32_t sign = static_cast<uint32_t>(half & 0x8000u) << 16;
+    uint32_t exponent = (half >> 10) & 0x1fu;
+    uint32_t mantissa = half & 0x3ffu;
+
+    uint32_t bits;
+    if (exponent == 0) {
+        float value = static_cast<float>(mantissa) * (1.0f / 16777216.0f);  // mantissa * 2^-24
+        return sign ? -value : value;
+    } else if (exponent == 31) {
+        bits = sign | 0x7f800000u | (mantissa << 13);
+    } else {
+        bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+    }
+    float value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+// Packs a unit normal as 10:10:10:2 signed normalized (w = 0)
+inline uint32_t packNormal1010102(float x, float y, float z) {
+    const float components[3] = {x, y, z};
+    uint32_t packed = 0;
+    for (int k = 0; k < 3; k++) {
+        float c = components[k] < -1.0f ? -1.0f : (components[k] > 1.0f ? 1.0f : components[k]);
+        int value = static_cast<int>(c * 511.0f + (c < 0 ? -0.5f : 0.5f));
+        packed |= (static_cast<uint32_t>(value) & 0x3ffu) << (10 * k);
+    }
+    return packed;
+}
+
+// Unpacks a 10:10:10:2 signed normalized normal (same rule as the GPU: max(c / 511, -1))
+inline void unpackNormal1010102(uint32_t packed, float& x, float& y, float& z) {
+    float* components[3] = {&x, &y, &z};
+    for (int k = 0; k < 3; k++) {
+        int value = static_cast<int>((packed >> (10 * k)) & 0x3ffu);
+        if (value >= 512) value -= 1024;
+        float c = value / 511.0f;
+        *components[k] = c < -1.0f ? -1.0f : c;
+    }
+}
+
+/**
+ * @brief Encodes one vertex of a quantized file
+ *
+ * @param q Quantization grid of the file
+ * @param position Position (inside the file's bounding box)
+ * @param normal Unit normal
+ * @param texCoord Texture coordinates
+ * @param out MESH_QUANTIZED_VERTEX_SIZE bytes
+ */
+inline void packQuantizedVertex(const MeshPositionQuantization& q, const float position[3],
+                                const float normal[3], const float texCoord[2], unsigned char* out) {
+    for (int k = 0; k < 3; k++) {
+        float steps = (position[k] - q.center[k]) / q.scale;
+        steps = steps < -32767.0f ? -32767.0f : (steps > 32767.0f ? 32767.0f : steps);
+        int value = static_cast<int>(steps + (steps < 0 ? -0.5f : 0.5f));
+        storeLE16(out + 2 * k, static_cast<uint16_t>(static_cast<int16_t>(value)));
+    }
+    storeLE16(out + 6, 0);
+    storeLE32(out + 8, packNormal1010102(normal[0], normal[1], normal[2]));
+    storeLE16(out + 12, floatToHalf(texCoord[0]));
+    storeLE16(out + 14, floatToHalf(texCoord[1]));
+}
+
+/**
+ * @brief Decodes one vertex of a quantized file
+ *
+ * @param q Quantization grid of the file
+ * @param in MESH_QUANTIZED_VERTEX_SIZE bytes
+ * @param position Receives the position
+ * @param normal Receives the normal
+ * @param texCoord Receives the texture coordinates
+ */
+inline void unpackQuantizedVertex(const MeshPositionQuantization& q, const unsigned char* in,
+                                  float position[3], float normal[3], float texCoord[2]) {
+    for (int k = 0; k < 3; k++) {
+        int16_t value = static_cast<int16_t>(loadLE16(in + 2 * k));
+        position[k] = q.center[k] + value * q.scale;
+    }
+    unpackNormal1010102(loadLE32(in + 8), normal[0], normal[1], normal[2]);
+    texCoord[0] = halfToFloat(loadLE16(in + 12));
+    texCoord[1] = halfToFloat(loadLE16(in + 14));
+}
+
+#endif // MESH_FORMAT_H
@@ -1,6 +1,7 @@
-    #include "engine.h"
+    #include "catmullrom.h"
     #include <vector>
     #include <cmath>
+    #include <algorithm>
 
     //AUX: multiply a 4x4 matrix by a 4x1 vector
     void multMatrixVector(const float* m, const float* v, float* res) {
@@ -20,43 +21,135 @@
         0.0f,  1.0f,  0.0f,  0.0f
     };
 
-    //Calculate a point and derivative on a Catmull-Rom segment
-    void getCatmullRomPoint(float t, const Point& p0, const Point& p1, const Point& p2, const Point& p3, float* pos, float* deriv) {
-        float T[4] = { t * t * t, t * t, t, 1 };
-        float dT[4] = { 3 * t * t, 2 * t, 1, 0 };
+    //Locate the segment of a closed curve at gt and the parameter within it
+    static const CatmullRomSegment& findSegment(const CatmullRomCurve& curve, float gt, float& t) {
+        int numSegments = curve.segments.size();
+        t = gt * numSegments;
+        int index = (int)floor(t);
+        t = t - index;
+        index %= numSegments;
+        if (index < 0) index += numSegments;
+        return curve.segments[index];
+    }
+
+    //Precompute the polynomial of every segment: coefficients = M * (p0, p1, p2, p3) per axis
+    void buildCatmullRomSegments(CatmullRomCurve& curve) {
+        const std::vector<Point>& points = curve.points;
+        int numPoints = points.size();
+        curve.segments.resize(numPoints);
+        for (int i = 0; i < numPoints; i++) {
+            const Point& p0 = points[(i + numPoints - 1) % numPoints];
+            const Point& p1 = points[i];
+            const Point& p2 = points[(i + 1) % numPoints];
+            const Point& p3 = points[(i + 2) % numPoints];
+            float px[4] = { p0.x, p1.x, p2.x, p3.x };
+            float py[4] = { p0.y, p1.y, p2.y, p3.y };
+            float pz[4] = { p0.z, p1.z, p2.z, p3.z };
+
+            CatmullRomSegment& segment = curve.segments[i];
+            multMatrixVector(m, px, segment.x);
+            multMatrixVector(m, py, segment.y);
+            multMatrixVector(m, pz, segment.z);
+        }
+    }
+
+    //Evaluate many curves at once: gather each curve's segment into SoA arrays, then one branch-free loop
+    void evalCatmullRomCurves(const CatmullRomCurve* curves, const float* gt, size_t count, CatmullRomSamples& out) {
+        out.x.resize(count); out.y.resize(count); out.z.resize(count);
+        out.dx.resize(count); out.dy.resize(count); out.dz.resize(count);
+
+        // 13 arrays of count floats: local t, then the 4 coefficients of x, y and z
+        out.gathered.resize(count * 13);
+        float* t = out.gathered.data();
+        float* c = t + count;
+        for (size_t i = 0; i < count; i++) {
+            if (curves[i].segments.empty()) {
+                // Zero polynomial: evaluates to the origin
+                t[i] = 0.0f;
+                for (int k = 0; k < 12; k++) c[k * count + i] = 0.0f;
+                continue;
+            }
+            const CatmullRomSegment& s = findSegment(curves[i], gt[i], t[i]);
+            for (int k = 0; k < 4; k++) {
+                c[k * count + i] = s.x[k];
+                c[(4 + k) * count + i] = s.y[k];
+                c[(8 + k) * count + i] = s.z[k];
+            }
+        }
 
-        float px[4] = { p0.x, p1.x, p2.x, p3.x };
-        float py[4] = { p0.y, p1.y, p2.y, p3.y };
-        float pz[4] = { p0.z, p1.z, p2.z, p3.z };
+        const float* axes[3] = { c, c + 4 * count, c + 8 * count };
+        float* positions[3] = { out.x.data(), out.y.data(), out.z.data() };
+        float* derivs[3] = { out.dx.data(), out.dy.data(), out.dz.data() };
+        for (int k = 0; k < 3; k++) {
+            const float* c3 = axes[k];
+            const float* c2 = c3 + count;
+            const float* c1 = c2 + count;
+            const float* c0 = c1 + count;
+            float* pos = positions[k];
+            float* deriv = derivs[k];
+            for (size_t i = 0; i < count; i++) {
+                float ti = t[i];
+                pos[i] = ((c3[i] * ti + c2[i]) * ti + c1[i]) * ti + c0[i];
+                deriv[i] = (3 * c3[i] * ti + 2 * c2[i]) * ti + c1[i];
+            }
+        }
+    }
 
-        float ax[4], ay[4], az[4];
-        multMatrixVector(m, px, ax);
-        multMatrixVector(m, py, ay);
-        multMatrixVector(m, pz, az);
+    //Largest distance allowed between the polyline and the curve, relative to the control points' extent
+    static const float TESSELLATION_TOLERANCE = 0.001f;
+    //Every segment is split at least 1 << MIN and at most 1 << MAX times
+    static const int TESSELLATION_MIN_DEPTH = 1;
+    static const int TESSELLATION_MAX_DEPTH = 6;
 
-        pos[0] = ax[0] * T[0] + ax[1] * T[1] + ax[2] * T[2] + ax[3] * T[3];
-        pos[1] = ay[0] * T[0] + ay[1] * T[1] + ay[2] * T[2] + ay[3] * T[3];
-        pos[2] = az[0] * T[0] + az[1] * T[1] + az[2] * T[2] + az[3] * T[3];
+    static void evalSegment(const CatmullRomSegment& s, float t, float* pos) {
+        const float* c[3] = { s.x, s.y, s.z };
+        for (int k = 0; k < 3; k++) {
+            pos[k] = ((c[k][0] * t + c[k][1]) * t + c[k][2]) * t + c[k][3];
+        }
+    }
 
-        deriv[0] = ax[0] * dT[0] + ax[1] * dT[1] + ax[2] * dT[2] + ax[3] * dT[3];
-        deriv[1] = ay[0] * dT[0] + ay[1] * dT[1] + ay[2] * dT[2] + ay[3] * dT[3];
-        deriv[2] = az[0] * dT[0] + az[1] * dT[1] + az[2] * dT[2] + az[3] * dT[3];
+    //Emit the points of [t0, t1) on a segment, halving the interval while its midpoint strays from the chord
+    static void subdivideSegment(const CatmullRomSegment& s, float t0, const float* p0, float t1, const float* p1,
+                                 float tolerance, int depth, std::vector<Point>& out) {
+        float tm = (t0 + t1) * 0.5f;
+        float pm[3];
+        evalSegment(s, tm, pm);
+        float dx = pm[0] - (p0[0] + p1[0]) * 0.5f;
+        float dy = pm[1] - (p0[1] + p1[1]) * 0.5f;
+        float dz = pm[2] - (p0[2] + p1[2]) * 0.5f;
+        bool flat = dx * dx + dy * dy + dz * dz <= tolerance * tolerance;
+        if (depth >= TESSELLATION_MAX_DEPTH || (depth >= TESSELLATION_MIN_DEPTH && flat)) {
+            out.push_back(Point{ p0[0], p0[1], p0[2] });
+            return;
+        }
+        subdivideSegment(s, t0, p0, tm, pm, tolerance, depth + 1, out);
+        subdivideSegment(s, tm, pm, t1, p1, tolerance, depth + 1, out);
     }
 
-    //Get global Catmull-Rom point
-    void getGlobalCatmullRomPoint(float gt, const std::vector<Point>& points, float* pos, float* deriv) {
-        int numPoints = points.size();
-        float t = gt * numPoints;
-        int index = (int)floor(t);
-        t = t - index;
+    //Tessellate adaptively: straight stretches get few points, tight bends many
+    void tessellateCatmullRomCurve(CatmullRomCurve& curve) {
+        curve.polyline.clear();
+        if (curve.segments.empty()) return;
 
-        int indices[4];
-        indices[0] = (index + numPoints - 1) % numPoints;
-        indices[1] = (index) % numPoints;
-        indices[2] = (index + 1) % numPoints;
-        indices[3] = (index + 2) % numPoints;
+        const std::vector<Point>& points = curve.points;
+        float boxMin[3] = { points[0].x, points[0].y, points[0].z };
+        float boxMax[3] = { points[0].x, points[0].y, points[0].z };
+        for (const Point& p : points) {
+            const float v[3] = { p.x, p.y, p.z };
+            for (int k = 0; k < 3; k++) {
+                boxMin[k] = std::min(boxMin[k], v[k]);
+                boxMax[k] = std::max(boxMax[k], v[k]);
+            }
+        }
+        float dx = boxMax[0] - boxMin[0], dy = boxMax[1] - boxMin[1], dz = boxMax[2] - boxMin[2];
+        float tolerance = std::max(0.5f * std::sqrt(dx * dx + dy * dy + dz * dz) * TESSELLATION_TOLERANCE, 1e-6f);
 
-        getCatmullRomPoint(t, points[indices[0]], points[indices[1]], points[indices[2]], points[indices[3]], pos, deriv);
+        for (const CatmullRomSegment& s : curve.segments) {
+            float p0[3], p1[3];
+            evalSegment(s, 0.0f, p0);
+            evalSegment(s, 1.0f, p1);
+            subdivideSegment(s, 0.0f, p0, 1.0f, p1, tolerance, 0, curve.polyline);
+        }
     }
 
     //Vector cross product
@@ -2,7 +2,13 @@
 #include <vector>
 #include "engine.h"
 
-void getGlobalCatmullRomPoint(float gt, const std::vector<Point>& points, float* pos, float* deriv);
+// Precomputes the cubic coefficients of every segment of a closed curve (call once after parsing)
+void buildCatmullRomSegments(CatmullRomCurve& curve);
+
+// Evaluates curves[i] at gt[i] for i < count into out (SoA, so the polynomial loop vectorizes)
+void evalCatmullRomCurves(const CatmullRomCurve* curves, const float* gt, size_t count, CatmullRomSamples& out);
+// Fills curve.polyline with a line loop through the curve, adding points where it bends (segments needed)
+void tessellateCatmullRomCurve(CatmullRomCurve& curve);
 void cross(const float* a, const float* b, float* res);
 void normalize(float* v);
 void buildRotMatrix(const float* x, const float* y, const float* z, float* m);
\ No newline at end of file
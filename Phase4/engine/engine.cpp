@@ -24,9 +24,24 @@
 #include "texture.h"
 #include "xmlParser.h" 
 #include "catmullrom.h" 
+#include "modelLoader.h"
+#include "meshCache.h"
+#include "jobSystem.h"
+#include "matrix.h"
+#include "scene.h"
+#include "instancing.h"
+#include "frustum.h"
+#include "lod.h"
+#include "trajectories.h"
+#include "frameClock.h"
+#include "renderQueue.h"
+#include "glStateCache.h"
 #include <fstream>
 #include <iostream>
+#include <algorithm>
 #include <cmath>
+#include <cstdlib>
+#include <cstring>
 #include <vector>
 #include <limits>
 #include <sstream>
@@ -51,7 +66,7 @@ float mouseSensitivity = 0.2f;
 bool showDebugMenu = false;      //Boolean to check if debug menu is shown
 int frameCount = 0;              
 float fps = 0.0f;                
-int lastTime = 0;                //Fps tracker
+double lastTime = 0.0;           //Fps tracker (frameClock.realTime)
 
 
 /**
@@ -62,110 +77,117 @@ int lastTime = 0;                //Fps tracker
  */
 World world;
 
+/**
+ * @brief Clock every animated transform of a frame is evaluated with
+ *
+ * P pauses it and [ ] halve or double its speed; --time-scale and
+ * --fixed-step set it up from the command line.
+ */
+FrameClock frameClock;
+
+/**
+ * @brief Selects how model files are loaded (set with the --mmap option)
+ */
+ModelLoadMode modelLoadMode = LOAD_STREAM;
+
+/**
+ * @brief Bytes of finished assets uploaded to the GPU per frame
+ *
+ * Keeps frames responsive while a large scene streams in.
+ */
+const size_t UPLOAD_BUDGET_BYTES = 16 * 1024 * 1024;
+
+/**
+ * @brief Whether models are drawn in instanced batches (see instancing.h)
+ *
+ * Enabled at startup when supported, unless --no-instancing is given.
+ */
+bool instancingEnabled = false;
+
+/**
+ * @brief Draw calls issued for models in the last frame
+ */
+int modelDrawCalls = 0;
+
+/**
+ * @brief Models queued for drawing this frame, and the GL state changes drawing them took
+ *
+ * The queue is only used without instancing (see renderQueue.h); --no-sort
+ * draws it in scene order, to compare the state changes. The stats come
+ * from the instanced batches when instancing is on.
+ */
+std::vector<DrawItem> drawQueue;
+RenderStateStats renderStats;
+bool renderSortEnabled = true;
+
+/**
+ * @brief Nodes whose trajectory is drawn this frame, and the draw calls that took
+ *
+ * Filled by the node sweep (culled groups are left out) and drawn
+ * afterwards in one pass, see trajectories.h.
+ */
+std::vector<unsigned> visibleTrajectories;
+int trajectoryDrawCalls = 0;
+
+/**
+ * @brief Whether models outside the view frustum are skipped
+ *
+ * Disabled with --no-culling.
+ */
+bool cullingEnabled = true;
+
+/**
+ * @brief Models drawn and culled in the last frame (loaded meshes only)
+ */
+int modelsDrawn = 0;
+int modelsCulled = 0;
+
+/**
+ * @brief Subtrees rejected by one test of their bounds in the last frame
+ */
+int subtreesCulled = 0;
+
+/**
+ * @brief Projection matrix and its frustum planes (eye space), set in changeSize
+ */
+float projectionMatrix[16];
+Frustum viewFrustum;
+
+/**
+ * @brief Whether models pick a level of detail by screen size (see lod.h)
+ *
+ * Disabled with --no-lod, which always draws the finest level.
+ */
+bool lodEnabled = true;
+
+/**
+ * @brief Pixels per unit of eye-space size at distance 1, set in changeSize
+ */
+float lodPixelScale = 1.0f;
+
+/**
+ * @brief Triangles drawn in the last frame
+ */
+size_t trianglesDrawn = 0;
+
 /**
  * @brief Loads a 3D model from a file into memory
  * 
- * Reads vertex data from the specified file and stores it in the model's
- * vertices vector. Each vertex consists of x, y, z coordinates.
+ * Attaches the model to the shared mesh for its file (see meshCache.h), so
+ * a file referenced by many models is only read and uploaded once. In
+ * LOAD_MAPPED mode binary meshes go straight from the mapped file to the
+ * GPU.
  * 
  * @param model Reference to the Model object to populate with vertex data
  */
 void loadModel(Model& model) {
-    std::ifstream file(model.filename);
-    if (!file.is_open()) {
-        std::cerr << "Error opening file: " << model.filename << std::endl;
-        return;
-    }
-
-    std::vector<Point> vertices;
-    std::vector<Point> normals;
-    std::vector<float> texCoords;
-    
-    std::string line;
-    int lineNum = 0;
-    
-    while (std::getline(file, line)) {
-        ++lineNum;
-        std::istringstream iss(line);
-        
-        // Try to read as position + normal + texture format
-        Point vertex, normal;
-        float u, v;
-        
-        if (iss >> vertex.x >> vertex.y >> vertex.z >> normal.x >> normal.y >> normal.z >> u >> v) {
-            // Full format with position, normal, and texture
-            vertices.push_back(vertex);
-            normals.push_back(normal);
-            texCoords.push_back(u);
-            texCoords.push_back(v);
-        } else {
-            // Reset stream for retry
-            iss.clear();
-            iss.str(line);
-            
-            // Try to read as position + texture format
-            if (iss >> vertex.x >> vertex.y >> vertex.z >> u >> v) {
-                vertices.push_back(vertex);
-                texCoords.push_back(u);
-                texCoords.push_back(v);
-            } else {
-                // Reset stream for retry
-                iss.clear();
-                iss.str(line);
-                
-                // Try to read as position only format
-                if (iss >> vertex.x >> vertex.y >> vertex.z) {
-                    vertices.push_back(vertex);
-                } else {
-                    if (!file.eof()) {
-                        std::cerr << "Malformed line " << lineNum << " in " << model.filename << std::endl;
-                    }
-                }
-            }
-        }
-    }
-
-    if (vertices.empty()) {
-        std::cerr << "Warning: Model " << model.filename << " has no vertices!" << std::endl;
-        return;
-    }
-
-    model.vertices = vertices;
-    
-    // Store normals if available
-    if (!normals.empty()) {
-        model.normals = normals;
-    }
-    
-    // Store texture coordinates if available
-    if (!texCoords.empty()) {
-        model.texCoords = texCoords;
-    }
-
-    // Create and populate vertex buffer
-    if (model.vbo == 0) glGenBuffers(1, &model.vbo);
-    glBindBuffer(GL_ARRAY_BUFFER, model.vbo);
-    glBufferData(GL_ARRAY_BUFFER, model.vertices.size() * sizeof(Point), model.vertices.data(), GL_STATIC_DRAW);
-    
-    // Create and populate normal buffer if normals exist
-    if (!model.normals.empty()) {
-        if (model.nbo == 0) glGenBuffers(1, &model.nbo);
-        glBindBuffer(GL_ARRAY_BUFFER, model.nbo);
-        glBufferData(GL_ARRAY_BUFFER, model.normals.size() * sizeof(Point), model.normals.data(), GL_STATIC_DRAW);
-    }
-    
-    // Create and populate texture coordinate buffer if texture coordinates exist
-    if (!model.texCoords.empty()) {
-        if (model.tbo == 0) glGenBuffers(1, &model.tbo);
-        glBindBuffer(GL_ARRAY_BUFFER, model.tbo);
-        glBufferData(GL_ARRAY_BUFFER, model.texCoords.size() * sizeof(float), model.texCoords.data(), GL_STATIC_DRAW);
+    if (!model.mesh) {
+        model.mesh = acquireMesh(model.filename, modelLoadMode);
     }
     
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    
     // Load texture if specified
     if (!model.textureFile.empty()) {
-        model.textureID = loadTexture(model.textureFile);
+        model.textureID = loadTexture(model.textureFile, model.textureSampling);
         if (model.textureID == 0) {
             std::cerr << "Failed to load texture: " << model.textureFile << std::endl;
         }
@@ -173,201 +195,123 @@ void loadModel(Model& model) {
 }
 
 /**
- * @brief Draws a Catmull-Rom curve
- * 
- * Renders the trajectory of a Catmull-Rom curve using OpenGL line loops.
- * 
- * @param points The control points of the curve
- * @param samples Number of samples to draw the curve
+ * @brief View matrix of the current frame and whether it differs from the last one
  */
-void drawCatmullRomCurve(const std::vector<Point>& points, int samples = 100) {
-    if (points.size() < 4) return;
-    
-    // Save current lighting state
-    GLboolean lightingEnabled = glIsEnabled(GL_LIGHTING);
-    
-    // Disable lighting for drawing curves
-    glDisable(GL_LIGHTING);
-    glDisable(GL_TEXTURE_2D);
-    
-    glColor3f(0.7f, 0.7f, 0.7f); // Light gray for trajectory
-    glBegin(GL_LINE_LOOP);
-    for (int i = 0; i < samples; ++i) {
-        float t = (float)i / samples;
-        float pos[3], deriv[3];
-        getGlobalCatmullRomPoint(t, points, pos, deriv);
-        glVertex3f(pos[0], pos[1], pos[2]);
-    }
-    glEnd();
-    
-    // Restore previous lighting state
-    if (lightingEnabled) {
-        glEnable(GL_LIGHTING);
-    }
-    
-    glColor3f(1.0f, 1.0f, 1.0f); // Reset color
-}
-
-// Update your setupMaterial function to include debug output
-
-void setupMaterial(const Material& material) {
-    // Create material property arrays
-    float diffuse[4] = {material.diffuse.r, material.diffuse.g, material.diffuse.b, 1.0f};
-    float ambient[4] = {material.ambient.r, material.ambient.g, material.ambient.b, 1.0f};
-    float specular[4] = {material.specular.r, material.specular.g, material.specular.b, 1.0f};
-    
-    // Use the actual emissive color from the material
-    float emissive[4] = {material.emissive.r, material.emissive.g, material.emissive.b, 0.5f};
-    
-    // Apply all material properties for proper lighting
-    glMaterialfv(GL_FRONT, GL_DIFFUSE, diffuse);
-    glMaterialfv(GL_FRONT, GL_AMBIENT, ambient);
-    glMaterialfv(GL_FRONT, GL_SPECULAR, specular);
-    glMaterialfv(GL_FRONT, GL_EMISSION, emissive);
-    glMaterialf(GL_FRONT, GL_SHININESS, material.shininess);
-    
-    
-}
+float viewMatrix[16];
+bool viewChanged = true;
 
-// Update the renderGroup function to conditionally apply materials and textures
-void renderGroup(const Group& group) {
-    // Só desenha a trajetória se drawCurve for true
-    if (group.transform.hasCurve && group.transform.curvePoints.size() >= 4 && group.transform.drawCurve) {
-        drawCatmullRomCurve(group.transform.curvePoints);
-    }
+/**
+ * @brief Draws every node of the scene in one sweep over the node array
+ *
+ * Each node's subtree bound is tested first: a subtree off screen is
+ * skipped as a whole, and one entirely on screen needs no further tests.
+ * 
+ * @param scene The scene, with matrices and bounds updated for this frame
+ */
+void renderSceneNodes(Scene& scene) {
+    size_t insideEnd = 0;    // Nodes before this index are known to be inside the frustum
+    size_t refreshEnd = 0;   // Nodes before this index missed model-view updates while culled
+    size_t i = 0;
+    while (i < scene.nodes.size()) {
+        const SceneNode& node = scene.nodes[i];
+        unsigned char& flags = scene.nodeFlags[i];
 
-    glPushMatrix();
-    for (const auto& transform : group.transformOrder) {
-        if (transform == "translate") {
-            glTranslatef(group.transform.translateX, group.transform.translateY, group.transform.translateZ);
-        }
-        else if (transform == "translate_curve") {
-            float t = 0.0f;
-            if (group.transform.curveTime > 0.0f) {
-                float elapsed = glutGet(GLUT_ELAPSED_TIME) / 1000.0f;
-                t = fmod(elapsed / group.transform.curveTime, 1.0f);
-            }
-            float pos[3], deriv[3];
-            getGlobalCatmullRomPoint(t, group.transform.curvePoints, pos, deriv);
-            glTranslatef(pos[0], pos[1], pos[2]);
-            if (group.transform.align) {
-                float up[3] = {0, 1, 0}, side[3], m[16];
-                cross(deriv, up, side);
-                normalize(deriv); normalize(side);
-                cross(side, deriv, up);
-                buildRotMatrix(deriv, up, side, m);
-                glMultMatrixf(m);
+        if (cullingEnabled && i >= insideEnd) {
+            const float* bound = subtreeBound(scene, i);
+            FrustumTest test = bound[3] < 0 ? FRUSTUM_OUTSIDE
+                                            : testSphere(viewFrustum, viewMatrix, bound, bound[3]);
+            if (test == FRUSTUM_OUTSIDE) {
+                unsigned modelEnd = subtreeModelEnd(scene, i);
+                std::fill(scene.modelVisible.begin() + node.firstModel, scene.modelVisible.begin() + modelEnd, 0);
+                // A subtree without bounds has nothing loaded to draw, so it is not counted
+                if (bound[3] >= 0) {
+                    modelsCulled += modelEnd - node.firstModel;
+                    subtreesCulled++;
+                }
+                flags |= NODE_VIEW_STALE;
+                i = node.subtreeEnd;
+                continue;
             }
+            if (test == FRUSTUM_INSIDE) insideEnd = node.subtreeEnd;
         }
-        else if (transform == "rotate") {
-            if (group.transform.rotateAngle != 0.0f)
-                glRotatef(group.transform.rotateAngle, group.transform.rotateX, group.transform.rotateY, group.transform.rotateZ);
-        }
-        else if (transform == "rotate_time") {
-            float elapsed = glutGet(GLUT_ELAPSED_TIME) / 1000.0f;
-            float angle = fmod(elapsed / group.transform.rotationTime, 1.0f) * 360.0f;
-            glRotatef(angle, group.transform.rotateX, group.transform.rotateY, group.transform.rotateZ);
+        if (flags & NODE_VIEW_STALE) {
+            refreshEnd = std::max<size_t>(refreshEnd, node.subtreeEnd);
+            flags &= ~NODE_VIEW_STALE;
         }
-        else if (transform == "scale") {
-            glScalef(group.transform.scaleX, group.transform.scaleY, group.transform.scaleZ);
+
+        // Trajectories with draw set are queued here and drawn after the sweep,
+        // in their parent's space (see trajectories.h)
+        if (node.curve >= 0 && !scene.curves[node.curve].polyline.empty()) {
+            visibleTrajectories.push_back(static_cast<unsigned>(i));
         }
-    }
-    
-    //Renders all models in group.models
-    for (const Model& model : group.models) {
-        // Disable color material mode first
-        glDisable(GL_COLOR_MATERIAL);
-        
-        // Only apply materials if they are defined in the XML
-        bool hasDefinedMaterial = (model.material.diffuse.r > 0 || 
-                                   model.material.diffuse.g > 0 || 
-                                   model.material.diffuse.b > 0 ||
-                                   model.material.ambient.r > 0 || 
-                                   model.material.ambient.g > 0 || 
-                                   model.material.ambient.b > 0);
-        
-        if (hasDefinedMaterial) {
-            // Setup material properties
-            setupMaterial(model.material);
-        } else {
-            // Apply default material (white)
-            float defaultDiffuse[4] = {1.0f, 1.0f, 1.0f, 1.0f};
-            float defaultAmbient[4] = {0.2f, 0.2f, 0.2f, 1.0f};
-            float defaultSpecular[4] = {0.0f, 0.0f, 0.0f, 1.0f};
-            float defaultEmission[4] = {0.0f, 0.0f, 0.0f, 1.0f};
-            
-            glMaterialfv(GL_FRONT, GL_DIFFUSE, defaultDiffuse);
-            glMaterialfv(GL_FRONT, GL_AMBIENT, defaultAmbient);
-            glMaterialfv(GL_FRONT, GL_SPECULAR, defaultSpecular);
-            glMaterialfv(GL_FRONT, GL_EMISSION, defaultEmission);
-            glMaterialf(GL_FRONT, GL_SHININESS, 0.0f);
+
+        float* modelView = modelViewMatrix(scene, i);
+        if (viewChanged || i < refreshEnd || (flags & NODE_WORLD_CHANGED)) {
+            mat4Multiply(viewMatrix, worldMatrix(scene, i), modelView);
         }
-        
-        // Handle normals
-        if (model.nbo != 0 && !model.normals.empty()) {
-            glBindBuffer(GL_ARRAY_BUFFER, model.nbo);
-            glEnableClientState(GL_NORMAL_ARRAY);
-            glNormalPointer(GL_FLOAT, 0, 0);
-        } else {
-            // No normals available - use a default normal
-            glDisableClientState(GL_NORMAL_ARRAY);
-            glNormal3f(0.0f, 1.0f, 0.0f);
+        if (node.modelCount == 0) {
+            i++;
+            continue;
         }
-        
-        // Only setup texture if it's available
-        if (model.textureID > 0 && !model.textureFile.empty()) {
-            glEnable(GL_TEXTURE_2D);
-            glBindTexture(GL_TEXTURE_2D, model.textureID);
-            
-            if (model.tbo != 0 && !model.texCoords.empty()) {
-                glBindBuffer(GL_ARRAY_BUFFER, model.tbo);
-                glEnableClientState(GL_TEXTURE_COORD_ARRAY);
-                glTexCoordPointer(2, GL_FLOAT, 0, 0);
+
+        // Frustum test of each model's bounds, also used by the instanced batches
+        unsigned visibleCount = 0;
+        for (unsigned m = node.firstModel; m < node.firstModel + node.modelCount; m++) {
+            const Mesh* mesh = scene.models[m].mesh;
+            if (!mesh || mesh->vertexCount == 0) {
+                scene.modelVisible[m] = 0;
+                continue;
             }
-        } else {
-            glDisable(GL_TEXTURE_2D);
-            glDisableClientState(GL_TEXTURE_COORD_ARRAY);
-        }
+            bool visible = !cullingEnabled || i < insideEnd || isMeshVisible(viewFrustum, modelView, *mesh);
+            scene.modelVisible[m] = visible;
+            if (!visible) {
+                modelsCulled++;
+                continue;
+            }
+            visibleCount++;
+            modelsDrawn++;
 
-        // Render the model - also remove sizeof(Point) from glVertexPointer
-        if (model.vbo != 0 && !model.vertices.empty()) {
-            glBindBuffer(GL_ARRAY_BUFFER, model.vbo);
-            glEnableClientState(GL_VERTEX_ARRAY);
-            glVertexPointer(3, GL_FLOAT, 0, 0);  // Remove sizeof(Point) - it should be 0
-            
-            glDrawArrays(GL_TRIANGLES, 0, model.vertices.size());
+            // Level of detail for this frame, also used by the instanced batches
+            unsigned level = 0;
+            if (lodEnabled && !mesh->lods.empty()) {
+                float radius = projectedRadius(modelView, *mesh, lodPixelScale, world.camera.near);
+                level = selectMeshLevel(*mesh, scene.modelLod[m], radius);
+            }
+            scene.modelLod[m] = static_cast<unsigned char>(level);
+            trianglesDrawn += meshTriangleCount(meshLevel(*mesh, level));
         }
-        
-        // Disable client states and clean up
-        glDisableClientState(GL_VERTEX_ARRAY);
-        glDisableClientState(GL_NORMAL_ARRAY);
-        glDisableClientState(GL_TEXTURE_COORD_ARRAY);
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
-        glBindTexture(GL_TEXTURE_2D, 0);
-    }
-    
-    //Render the child models in xml
-    for (const Group& childGroup : group.childGroups) {
-        renderGroup(childGroup);
+        // Drawn after the sweep: sorted by state, or in instanced batches
+        if (visibleCount > 0 && !instancingEnabled) {
+            for (unsigned m = node.firstModel; m < node.firstModel + node.modelCount; m++) {
+                if (!scene.modelVisible[m]) continue;
+                queueModelDraw(drawQueue, scene, m, scene.modelLod[m], modelView, world.camera.far);
+            }
+        }
+        i++;
     }
-    glPopMatrix(); //Reset the transformation matrix
+
+    renderStats = submitRenderQueue(drawQueue, scene, renderSortEnabled);
+    modelDrawCalls = renderStats.draws;
+
+    unbindMeshArrays();
+    cachedBindTexture(0);
 }
 
 // Update the setupLights function to handle the case with no lights
 void setupLights(const std::vector<Light>& lights) {
     // Disable all lights first
     for (int i = 0; i < 8; i++) {
-        glDisable(GL_LIGHT0 + i);
+        cachedEnable(GL_LIGHT0 + i, false);
     }
     
     // If no lights specified in the XML, disable lighting completely
     if (lights.empty()) {
-        glDisable(GL_LIGHTING);
+        cachedEnable(GL_LIGHTING, false);
         return;
     }
     
     // Enable lighting
-    glEnable(GL_LIGHTING);
+    cachedEnable(GL_LIGHTING, true);
     
     // Configure lights as specified in the XML
     for (size_t i = 0; i < lights.size() && i < 8; i++) {
@@ -411,7 +355,7 @@ void setupLights(const std::vector<Light>& lights) {
         }
         
         // Now enable the light
-        glEnable(lightID);
+        cachedEnable(lightID, true);
     }
 }
 
@@ -637,6 +581,8 @@ void mouseMotion(int x, int y) {
     glutPostRedisplay();
 }
 
+void unloadModels(Scene& scene);
+
 void keyPressed(unsigned char key, int x, int y) {
     keys[key] = true;
     
@@ -649,9 +595,19 @@ void keyPressed(unsigned char key, int x, int y) {
         std::cout << "Debug menu toggled: " << (showDebugMenu ? "ON" : "OFF") << std::endl;
     }
     
+    // Animation clock: pause and speed
+    if (key == 'p' || key == 'P') {
+        frameClock.paused = !frameClock.paused;
+    }
+    if (key == '[') frameClock.timeScale *= 0.5;
+    if (key == ']') frameClock.timeScale *= 2.0;
+
     // ESC key to quit
-    if (key == 27) 
+    if (key == 27) {
+        stopJobWorkers();
+        unloadModels(world.scene);
         exit(0);
+    }
         
     glutPostRedisplay();
 }
@@ -672,9 +628,9 @@ void keyReleased(unsigned char key, int x, int y) {
  */
 void renderText(const char* text, float x, float y) {
     // Save current states
-    GLboolean depthEnabled = glIsEnabled(GL_DEPTH_TEST);
-    GLboolean lightingEnabled = glIsEnabled(GL_LIGHTING);
-    GLboolean textureEnabled = glIsEnabled(GL_TEXTURE_2D);
+    bool depthEnabled = cachedIsEnabled(GL_DEPTH_TEST);
+    bool lightingEnabled = cachedIsEnabled(GL_LIGHTING);
+    bool textureEnabled = cachedIsEnabled(GL_TEXTURE_2D);
     
     // Save current matrices
     glMatrixMode(GL_PROJECTION);
@@ -687,9 +643,9 @@ void renderText(const char* text, float x, float y) {
     glLoadIdentity();
     
     // Disable features that could interfere with text rendering
-    glDisable(GL_DEPTH_TEST);
-    glDisable(GL_LIGHTING);
-    glDisable(GL_TEXTURE_2D);
+    cachedEnable(GL_DEPTH_TEST, false);
+    cachedEnable(GL_LIGHTING, false);
+    cachedEnable(GL_TEXTURE_2D, false);
     
     // Set text color to white
     glColor3f(1.0f, 1.0f, 1.0f);
@@ -701,9 +657,9 @@ void renderText(const char* text, float x, float y) {
     }
     
     // Restore settings
-    if (depthEnabled) glEnable(GL_DEPTH_TEST);
-    if (lightingEnabled) glEnable(GL_LIGHTING);
-    if (textureEnabled) glEnable(GL_TEXTURE_2D);
+    if (depthEnabled) cachedEnable(GL_DEPTH_TEST, true);
+    if (lightingEnabled) cachedEnable(GL_LIGHTING, true);
+    if (textureEnabled) cachedEnable(GL_TEXTURE_2D, true);
     
     // Restore matrices
     glPopMatrix();
@@ -712,33 +668,20 @@ void renderText(const char* text, float x, float y) {
     glMatrixMode(GL_MODELVIEW);
 }
 
-/**
- * @brief Recursively counts models in the scene graph
- * 
- * @param group The group to count models in
- * @param count Reference to the counter variable
- */
-void countModels(const Group& group, int& count) {
-    count += group.models.size();
-    for (const Group& childGroup : group.childGroups) {
-        countModels(childGroup, count);
-    }
-}
-
 GLuint skyboxTexture = 0;
 
 void renderSkybox(float size) {
     // Skip if no skybox texture is loaded
-    if (skyboxTexture == 0) return;
+    if (skyboxTexture == 0 || !isTextureReady(skyboxTexture)) return;
     
     // Save current state
-    GLboolean depthTest = glIsEnabled(GL_DEPTH_TEST);
-    GLboolean lighting = glIsEnabled(GL_LIGHTING);
+    bool depthTest = cachedIsEnabled(GL_DEPTH_TEST);
+    bool lighting = cachedIsEnabled(GL_LIGHTING);
     
     // Setup skybox rendering
-    glDisable(GL_LIGHTING);
-    glDisable(GL_DEPTH_TEST);
-    glEnable(GL_TEXTURE_2D);
+    cachedEnable(GL_LIGHTING, false);
+    cachedEnable(GL_DEPTH_TEST, false);
+    cachedEnable(GL_TEXTURE_2D, true);
     
     // Save matrix state
     glMatrixMode(GL_MODELVIEW);
@@ -747,7 +690,7 @@ void renderSkybox(float size) {
     // Only use the rotational component of the view matrix
     // This makes the skybox move with the camera
     float modelview[16];
-    glGetFloatv(GL_MODELVIEW_MATRIX, modelview);
+    mat4Copy(viewMatrix, modelview);
     
     // Zero out the translation
     modelview[12] = 0;
@@ -757,7 +700,7 @@ void renderSkybox(float size) {
     glLoadMatrixf(modelview);
     
     // Bind skybox texture
-    glBindTexture(GL_TEXTURE_2D, skyboxTexture);
+    cachedBindTexture(skyboxTexture);
     
     // Draw skybox cube
     glBegin(GL_QUADS);
@@ -804,42 +747,73 @@ void renderSkybox(float size) {
     glPopMatrix();
     
     // Restore OpenGL state
-    if (depthTest) glEnable(GL_DEPTH_TEST);
-    if (lighting) glEnable(GL_LIGHTING);
+    if (depthTest) cachedEnable(GL_DEPTH_TEST, true);
+    if (lighting) cachedEnable(GL_LIGHTING, true);
     
-    glBindTexture(GL_TEXTURE_2D, 0);
+    cachedBindTexture(0);
 }
 
 void renderScene() {
+    // Upload assets finished by the loader workers since the last frame
+    if (processUploads(UPLOAD_BUDGET_BYTES) > 0) {
+        invalidateInstanceBatches();
+        invalidateSceneBounds(world.scene);
+    }
+
+    // The one clock reading of this frame
+    tickFrameClock(frameClock);
+    resetGLStateCacheStats();
+
     frameCount++;
-    int currentTime = glutGet(GLUT_ELAPSED_TIME);
-    int timeInterval = currentTime - lastTime;
+    double timeInterval = frameClock.realTime - lastTime;
     //update fps every second
-    if (timeInterval >= 1000) { 
-        fps = frameCount * 1000.0f / timeInterval;
-        lastTime = currentTime;
+    if (timeInterval >= 1.0) { 
+        fps = static_cast<float>(frameCount / timeInterval);
+        lastTime = frameClock.realTime;
         frameCount = 0;
     }
     updateCamera();
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-    glLoadIdentity();
-    
-    gluLookAt(world.camera.position.x, world.camera.position.y, world.camera.position.z,
-              world.camera.lookAt.x, world.camera.lookAt.y, world.camera.lookAt.z,
-              world.camera.up.x, world.camera.up.y, world.camera.up.z);
+
+    // Model-view matrices are cached per group, so the view only needs
+    // to be combined again when the camera moved
+    float eye[3] = {world.camera.position.x, world.camera.position.y, world.camera.position.z};
+    float center[3] = {world.camera.lookAt.x, world.camera.lookAt.y, world.camera.lookAt.z};
+    float up[3] = {world.camera.up.x, world.camera.up.y, world.camera.up.z};
+    float newView[16];
+    mat4LookAt(newView, eye, center, up);
+    viewChanged = viewChanged || memcmp(newView, viewMatrix, sizeof(viewMatrix)) != 0;
+    mat4Copy(newView, viewMatrix);
+    glLoadMatrixf(viewMatrix);
     
     // Render skybox before anything else
     renderSkybox(500.0f);  // Use a large size to ensure it's behind everything
     
     setupLights(world.lights);
-    renderGroup(world.rootGroup);
+
+    updateSceneMatrices(world.scene, frameClock.time);
+    updateSceneBounds(world.scene);
+    modelDrawCalls = 0;
+    modelsDrawn = 0;
+    modelsCulled = 0;
+    subtreesCulled = 0;
+    trianglesDrawn = 0;
+    visibleTrajectories.clear();
+    renderSceneNodes(world.scene);
+    if (instancingEnabled) {
+        int lightCount = static_cast<int>(std::min<size_t>(world.lights.size(), 8));
+        renderStats = drawInstancedModels(world.scene, lightCount);
+        modelDrawCalls = renderStats.draws;
+    }
+    trajectoryDrawCalls = drawTrajectories(world.scene, visibleTrajectories, viewMatrix);
+    viewChanged = false;
     
     if (showDebugMenu) {
         char buffer[256]; // Increase buffer size to prevent overflow
         
         // Save OpenGL states that might affect text rendering
-        glDisable(GL_LIGHTING);
-        glDisable(GL_TEXTURE_2D);
+        cachedEnable(GL_LIGHTING, false);
+        cachedEnable(GL_TEXTURE_2D, false);
         
         // Uses a buffer to store information on fps and "print" it on the screen with snprintf
         snprintf(buffer, sizeof(buffer), "FPS: %.1f", fps);
@@ -858,9 +832,8 @@ void renderScene() {
         renderText(buffer, 10, world.window.height - 80);
         
        
-        int totalModels = 0;
-        countModels(world.rootGroup, totalModels);
-        snprintf(buffer, sizeof(buffer), "Total Models: %d", totalModels);
+        snprintf(buffer, sizeof(buffer), "Total Models: %zu (%zu groups)",
+                world.scene.models.size(), world.scene.nodes.size());
         renderText(buffer, 10, world.window.height - 100);
         
         snprintf(buffer, sizeof(buffer), "Lights: %zu", world.lights.size());
@@ -882,33 +855,93 @@ void renderScene() {
         }
 
         // Add material information for the first model in the first group (for debugging)
-        if (!world.rootGroup.models.empty()) {
-            const Model& model = world.rootGroup.models[0];
+        if (!world.scene.nodes.empty() && world.scene.nodes[0].modelCount > 0) {
+            const Material& material = world.scene.materials[0];
             snprintf(buffer, sizeof(buffer), "First Model Material: Diff=(%.2f,%.2f,%.2f) Spec=(%.2f,%.2f,%.2f) Shin=%.1f", 
-                    model.material.diffuse.r, model.material.diffuse.g, model.material.diffuse.b,
-                    model.material.specular.r, model.material.specular.g, model.material.specular.b,
-                    model.material.shininess);
+                    material.diffuse.r, material.diffuse.g, material.diffuse.b,
+                    material.specular.r, material.specular.g, material.specular.b,
+                    material.shininess);
             renderText(buffer, 10, world.window.height - 160);
         }
+
+        TextureCacheStats texStats = getTextureCacheStats();
+        snprintf(buffer, sizeof(buffer), "Textures: %zu (%.1f MB) Cache hits=%zu misses=%zu",
+                texStats.textureCount, texStats.totalBytes / (1024.0f * 1024.0f),
+                texStats.hits, texStats.misses);
+        renderText(buffer, 10, world.window.height - 180);
+
+        size_t pendingMeshes = pendingMeshCount();
+        if (pendingMeshes > 0 || texStats.pending > 0) {
+            snprintf(buffer, sizeof(buffer), "Loading: %zu meshes, %zu textures",
+                    pendingMeshes, texStats.pending);
+            renderText(buffer, 10, world.window.height - 200);
+        }
+
+        snprintf(buffer, sizeof(buffer), "Model draw calls: %d%s, trajectories: %d", modelDrawCalls,
+                instancingEnabled ? " (instanced)" : "", trajectoryDrawCalls);
+        renderText(buffer, 10, world.window.height - 220);
+
+        snprintf(buffer, sizeof(buffer),
+                "State changes: %d textures, %d materials, %d meshes, %d matrices, %d programs%s",
+                renderStats.textureChanges, renderStats.materialChanges, renderStats.meshChanges,
+                renderStats.matrixLoads, renderStats.programChanges,
+                instancingEnabled ? " (instanced)" : renderSortEnabled ? "" : " (unsorted)");
+        renderText(buffer, 10, world.window.height - 300);
+
+        snprintf(buffer, sizeof(buffer), "Culled: %d of %d models, %d whole groups%s", modelsCulled,
+                modelsDrawn + modelsCulled, subtreesCulled, cullingEnabled ? "" : " (culling off)");
+        renderText(buffer, 10, world.window.height - 240);
+
+        snprintf(buffer, sizeof(buffer), "Triangles: %zu%s", trianglesDrawn,
+                lodEnabled ? "" : " (LOD off)");
+        renderText(buffer, 10, world.window.height - 260);
+
+        if (frameClock.fixedStep > 0.0) {
+            snprintf(buffer, sizeof(buffer), "Time: %.2f s (fixed step %.4f s, frame %llu)%s", frameClock.time,
+                    frameClock.fixedStep, static_cast<unsigned long long>(frameClock.frame),
+                    frameClock.paused ? " (paused)" : "");
+        } else {
+            snprintf(buffer, sizeof(buffer), "Time: %.2f s (x%.3g)%s", frameClock.time, frameClock.timeScale,
+                    frameClock.paused ? " (paused)" : "");
+        }
+        renderText(buffer, 10, world.window.height - 280);
         
-        renderText("Controls: WASD=Move QE=Up/Down IJKL=Rotate +-=Zoom R=Reset F=Toggle Wireframe H=Toggle Debug ESC=Quit",
+        // Calls made from here to the end of the frame are not counted
+        GLStateCacheStats stateStats = getGLStateCacheStats();
+        snprintf(buffer, sizeof(buffer), "GL state calls: %zu issued, %zu filtered", stateStats.issued,
+                stateStats.filtered);
+        renderText(buffer, 10, world.window.height - 320);
+
+        renderText("Controls: WASD=Move QE=Up/Down IJKL=Rotate +-=Zoom R=Reset F=Toggle Wireframe H=Toggle Debug P=Pause []=Speed ESC=Quit",
                   10, 20);
-                  
-        // Restore OpenGL state
-        if (glIsEnabled(GL_LIGHTING)) glEnable(GL_LIGHTING);
-        if (glIsEnabled(GL_TEXTURE_2D)) glEnable(GL_TEXTURE_2D);
     }
     
     glutSwapBuffers();
 }
 
-void loadModels(Group& group) {
-    for (Model& model : group.models) {
+void loadModels(Scene& scene) {
+    for (Model& model : scene.models) {
         loadModel(model);
     }
-    
-    for (Group& childGroup : group.childGroups) {
-        loadModels(childGroup);
+}
+
+/**
+ * @brief Releases the meshes and textures referenced by the scene
+ * 
+ * Must run while the OpenGL context is still alive so the shared buffers
+ * can be deleted when their last model lets go of them.
+ * 
+ * @param scene Scene to unload
+ */
+void unloadModels(Scene& scene) {
+    releaseTrajectories();
+    for (Model& model : scene.models) {
+        releaseMesh(model.mesh);
+        model.mesh = nullptr;
+        if (model.textureID != 0) {
+            releaseTexture(model.textureID);
+            model.textureID = 0;
+        }
     }
 }
 
@@ -929,7 +962,10 @@ void changeSize(int w, int h) {
     glLoadIdentity();
     glViewport(0, 0, w, h);
     
-    gluPerspective(world.camera.fov, ratio, world.camera.near, world.camera.far);
+    mat4Perspective(projectionMatrix, world.camera.fov, ratio, world.camera.near, world.camera.far);
+    glLoadMatrixf(projectionMatrix);
+    frustumFromProjection(projectionMatrix, viewFrustum);
+    lodPixelScale = projectionMatrix[5] * h * 0.5f;
     
     glMatrixMode(GL_MODELVIEW);
 }
@@ -951,13 +987,39 @@ void idleFunction() {
  * @return 0 on successful execution, 1 on error
  */
 int main(int argc, char** argv) {
-    if (argc != 2) {
-        std::cout << "Usage: " << argv[0] << " <configs/config.xml>" << std::endl;
+    // Optional flags come before the configuration file
+    const char* configFile = nullptr;
+    bool useInstancing = true;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--mmap") {
+            modelLoadMode = LOAD_MAPPED;
+        } else if (arg == "--no-instancing") {
+            useInstancing = false;
+        } else if (arg == "--no-culling") {
+            cullingEnabled = false;
+        } else if (arg == "--no-lod") {
+            lodEnabled = false;
+        } else if (arg == "--no-sort") {
+            renderSortEnabled = false;
+        } else if (arg == "--time-scale" && i + 1 < argc) {
+            frameClock.timeScale = atof(argv[++i]);
+        } else if (arg == "--fixed-step" && i + 1 < argc) {
+            frameClock.fixedStep = atof(argv[++i]);
+        } else if (!configFile) {
+            configFile = argv[i];
+        } else {
+            configFile = nullptr;
+            break;
+        }
+    }
+    if (!configFile) {
+        std::cout << "Usage: " << argv[0] << " [--mmap] [--no-instancing] [--no-culling] [--no-lod] [--no-sort] [--time-scale X] [--fixed-step S] <configs/config.xml>" << std::endl;
         return 1;
     }
 
     // Get the filename without path for checking
-    std::string filename = argv[1];
+    std::string filename = configFile;
     size_t lastSlash = filename.find_last_of("/\\");
     std::string baseFilename = (lastSlash != std::string::npos) ? 
                            filename.substr(lastSlash + 1) : filename;
@@ -965,7 +1027,7 @@ int main(int argc, char** argv) {
     // Only load skybox for dynamic_solar_system.xml
     bool enableSkybox = (baseFilename == "dynamic_solar_system.xml");
     
-    world = parseXMLFile(argv[1]);
+    world = parseXMLFile(configFile);
     initCameraAngles();
     glutInit(&argc, argv);
     glutInitDisplayMode(GLUT_DEPTH | GLUT_DOUBLE | GLUT_RGBA);
@@ -983,7 +1045,14 @@ int main(int argc, char** argv) {
     }
 #endif
 
-    loadModels(world.rootGroup);
+    if (useInstancing) {
+        instancingEnabled = initInstancing();
+    }
+    uploadTrajectories(world.scene);
+
+    // Models and textures load on the worker pool while the window is already up
+    startJobWorkers();
+    loadModels(world.scene);
 
     // Only load skybox if it's specified in the XML
     skyboxTexture = 0;
@@ -992,14 +1061,14 @@ int main(int argc, char** argv) {
         if (skyboxTexture == 0) {
             std::cerr << "Failed to load skybox texture: " << world.skyboxTexture << std::endl;
         } else {
-            std::cout << "Successfully loaded skybox texture with ID: " << skyboxTexture << std::endl;
+            std::cout << "Queued skybox texture with ID: " << skyboxTexture << std::endl;
         }
     }
 
     // Initialize OpenGL lighting only if lights are defined in the XML
     if (!world.lights.empty()) {
-        glEnable(GL_LIGHTING);
-        glEnable(GL_NORMALIZE);
+        cachedEnable(GL_LIGHTING, true);
+        cachedEnable(GL_NORMALIZE, true);
         glShadeModel(GL_SMOOTH);
 
         // Set up global ambient light
@@ -1009,7 +1078,7 @@ int main(int argc, char** argv) {
         glLightModeli(GL_LIGHT_MODEL_LOCAL_VIEWER, GL_TRUE);
     } else {
         // If no lights defined, start with lighting disabled
-        glDisable(GL_LIGHTING);
+        cachedEnable(GL_LIGHTING, false);
     }
 
     glutDisplayFunc(renderScene);
@@ -1025,9 +1094,9 @@ int main(int argc, char** argv) {
     
     glutIdleFunc(idleFunction);
     
-    glEnable(GL_DEPTH_TEST);
-    glEnable(GL_CULL_FACE);
-    glEnable(GL_NORMALIZE);  // Normalize normals when scaling is applied
+    cachedEnable(GL_DEPTH_TEST, true);
+    cachedEnable(GL_CULL_FACE, true);
+    cachedEnable(GL_NORMALIZE, true);  // Normalize normals when scaling is applied
     glDepthFunc(GL_LESS);
     glCullFace(GL_BACK);
     glFrontFace(GL_CCW);
@@ -1036,10 +1105,11 @@ int main(int argc, char** argv) {
     glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
 
     // Add this in your OpenGL initialization
-    glEnable(GL_TEXTURE_2D);
+    cachedEnable(GL_TEXTURE_2D, true);
 
-    // Initialize FPS timer variables
-    lastTime = glutGet(GLUT_ELAPSED_TIME);
+    // Initialize FPS timer variables (animation starts at zero on the first frame)
+    resetFrameClock(frameClock);
+    lastTime = 0.0;
     frameCount = 0;
 
     glutMainLoop();
@@ -1,8 +1,11 @@
 #ifndef ENGINE_STRUCTS_H
 #define ENGINE_STRUCTS_H
 
+#include <cstdint>
+#include <memory>
 #include <vector>
 #include <string>
+#include "textureSampling.h"
 
 #ifdef __APPLE__
 #include <OpenGL/gl3.h>
@@ -46,50 +49,143 @@ struct Light {
     float intensity = 1.0f;           // Intensity of the light
 };
 
-// Structure for a 3D model
+// Geometry loaded from one model file, shared by every Model that uses it (see meshCache.h)
+struct Mesh {
+    std::string path;         // Canonical path of the file (cache key)
+    GLuint vbo = 0;  // Vertex buffer: positions, then normals and texture coordinates if present
+    GLuint ibo = 0;  // Index buffer object (0 = triangle list)
+    GLuint vao = 0;  // Vertex array object recording the buffer layout (0 if unsupported)
+    GLsizei vertexStride = 0;    // Bytes from one vertex to the next (0 = one block per attribute)
+    GLintptr normalOffset = -1;  // Byte offset of the first normal in vbo (-1 = no normals)
+    GLintptr texCoordOffset = -1; // Byte offset of the first texture coordinate in vbo (-1 = none)
+    GLenum positionType = GL_FLOAT;   // Component types in vbo (see meshFormat.h for quantized meshes)
+    GLenum normalType = GL_FLOAT;
+    GLenum texCoordType = GL_FLOAT;
+    bool quantized = false;           // Positions are steps of positionScale around positionOffset
+    float positionScale = 1.0f;
+    float positionOffset[3] = {0.0f, 0.0f, 0.0f};
+    float boundsMin[3] = {0.0f, 0.0f, 0.0f};      // Axis-aligned bounding box of the positions
+    float boundsMax[3] = {0.0f, 0.0f, 0.0f};
+    float boundsCenter[3] = {0.0f, 0.0f, 0.0f};   // Bounding sphere (centred on the box)
+    float boundsRadius = -1.0f;                   // Negative until the mesh is loaded
+    GLsizei vertexCount = 0;  // Number of vertices uploaded to vbo
+    GLsizei indexCount = 0;   // Number of indices uploaded to ibo
+    std::vector<std::unique_ptr<Mesh> > lods;  // Coarser levels of detail, level 1 first (see meshFormat.h)
+    std::vector<Point> vertices;      // CPU copy, empty unless keepCpuCopy (see MeshResidency)
+    std::vector<Point> normals;
+    std::vector<float> texCoords;
+    std::vector<uint32_t> indices;
+    bool keepCpuCopy = false;         // Keep the arrays above after upload
+    int refCount = 0;         // Number of models referencing this mesh
+    bool pending = true;      // Still being loaded by a worker (see jobSystem.h)
+    unsigned loadId = 0;      // Identifies the load job that fills this mesh
+};
+
+// Structure for a 3D model (its material is in Scene::materials at the same index)
 struct Model {
     std::string filename;
     std::string textureFile;
-    GLuint vbo = 0;
-    GLuint nbo = 0;  // Normal buffer object
-    GLuint tbo = 0;  // Texture coordinate buffer object
+    TextureSampling textureSampling;
+    Mesh* mesh = nullptr;     // Shared geometry, owned by the mesh cache
     GLuint textureID = 0;
-    std::vector<Point> vertices;
-    std::vector<Point> normals;
-    std::vector<float> texCoords;
-    Material material;
 };
 
-// Structure for transformation information
-struct Transform {
-    // Translation
-    float translateX = 0.0f, translateY = 0.0f, translateZ = 0.0f;
-    
-    // Rotation
-    float rotateAngle = 0.0f, rotateX = 0.0f, rotateY = 0.0f, rotateZ = 0.0f;
-    bool timeRotation = false;
-    float rotationTime = 0.0f;
-    
-    // Scale
-    float scaleX = 1.0f, scaleY = 1.0f, scaleZ = 1.0f;
-    
-    // Catmull-Rom curve
-    bool hasCurve = false;
-    std::vector<Point> curvePoints;
-    float curveTime = 0.0f;
+// Kind of a transform step, in the order written in the XML
+enum TransformOpType {
+    OP_TRANSLATE,        // params: x, y, z
+    OP_TRANSLATE_CURVE,  // param is a curve index instead
+    OP_ROTATE,           // params: angle, x, y, z
+    OP_ROTATE_TIME,      // params: time, x, y, z
+    OP_SCALE             // params: x, y, z
+};
+
+// One transform step: its kind and where its parameters start in Scene::transformParams
+// (for OP_TRANSLATE_CURVE, param is the index of the curve in Scene::curves)
+struct TransformOp {
+    TransformOpType type;
+    unsigned param;
+};
+
+// Cubic polynomial of one curve segment per axis: ((c[0] t + c[1]) t + c[2]) t + c[3]
+struct CatmullRomSegment {
+    float x[4], y[4], z[4];
+};
+
+// Catmull-Rom curve of a timed translate
+struct CatmullRomCurve {
+    std::vector<Point> points;
+    float time = 0.0f;
     bool align = false;
-    bool drawCurve = true;
+    bool draw = true;
+    std::vector<CatmullRomSegment> segments;  // One per point, see buildCatmullRomSegments
+    std::vector<Point> polyline;              // Drawn line loop, see tessellateCatmullRomCurve
+};
+
+// Positions and derivatives of a batch of curve evaluations, one array per component
+struct CatmullRomSamples {
+    std::vector<float> x, y, z;      // Positions
+    std::vector<float> dx, dy, dz;   // Derivatives
+    std::vector<float> gathered;     // Scratch: local t and segment coefficients, SoA
+};
+
+// Flags of a scene node (Scene::nodeFlags)
+enum SceneNodeFlags {
+    NODE_ANIMATED = 1,       // Has time-dependent ops, so the local matrix changes every frame
+    NODE_DIRTY = 2,          // Local matrix must be rebuilt
+    NODE_WORLD_CHANGED = 4,  // World matrix changed in the last update
+    NODE_BOUNDS_DIRTY = 8,   // Subtree bounds must be refit (a child's bounds or a mesh changed)
+    NODE_VIEW_STALE = 16     // Subtree was culled, so its model-view matrices were not updated
 };
 
-// Forward declaration of Group
-struct Group;
+// A <group> of the scene graph; everything it owns is a range into the Scene arrays
+struct SceneNode {
+    int parent = -1;           // Index of the parent node (-1 for the root)
+    unsigned subtreeEnd = 0;   // One past the last node of this node's subtree
+    unsigned firstOp = 0;      // Range in Scene::transformOps
+    unsigned opCount = 0;
+    unsigned firstModel = 0;   // Range in Scene::models and Scene::materials
+    unsigned modelCount = 0;
+    int curve = -1;            // Curve drawn as this node's trajectory (-1 if none)
+};
+
+// Flattened scene graph: nodes in depth-first order (a parent always comes
+// before its children), so traversals are linear sweeps over the arrays
+struct Scene {
+    std::vector<SceneNode> nodes;
+
+    // Transforms
+    std::vector<TransformOp> transformOps;
+    std::vector<float> transformParams;
+    std::vector<CatmullRomCurve> curves;
+    double animationTime = -1.0;         // Time the animated matrices were last built for
+    std::vector<float> curveParams;      // Each curve's parameter this frame, in [0, 1)
+    CatmullRomSamples curveSamples;      // Each curve's position and derivative at that parameter
 
-// Structure for a group (contains models and child groups)
-struct Group {
-    Transform transform;
-    std::vector<std::string> transformOrder;
+    // Models, with their materials in a parallel array
     std::vector<Model> models;
-    std::vector<Group> childGroups;
+    std::vector<Material> materials;
+    std::vector<unsigned> materialIds;        // Same id for equal materials (render sort key)
+    std::vector<unsigned char> modelVisible;  // Frustum test result of the last frame
+    std::vector<unsigned char> modelLod;      // Level of detail of the last frame (see lod.h)
+
+    // Cached matrices, 16 floats (column-major) per node, and node flags
+    std::vector<float> localMatrices;
+    std::vector<float> worldMatrices;      // Parent world * local
+    std::vector<float> modelViewMatrices;  // View * world, loaded with glLoadMatrixf
+    std::vector<unsigned char> nodeFlags;
+
+    // World-space bounding sphere of each node's subtree, 4 floats per node
+    // (centre, radius; negative radius if nothing in it is drawn yet)
+    std::vector<float> subtreeBounds;
+    // Bounding sphere of each curve's drawn trajectory, in its parent's space
+    std::vector<float> curveBounds;
+
+    // Update plan (see updateSceneMatrices): nodes updated on the calling
+    // thread, then the subtrees rooted at updateRanges, concurrently
+    std::vector<unsigned> updateSerialNodes;
+    std::vector<unsigned> updateRanges;
+    std::vector<unsigned char> updateRangeChanged;  // Per range: its root's bound changed
+    size_t updatePlanSize = 0;                      // Node count the plan was made for
 };
 
 // Structure for camera information
@@ -112,13 +208,12 @@ struct Window {
 struct World {
     Camera camera;
     Window window;
-    Group rootGroup;
+    Scene scene;
     std::vector<Light> lights;
     std::string skyboxTexture; // Path to skybox texture
 };
 
 // Function declarations for Catmull-Rom splines
-void getGlobalCatmullRomPoint(float gt, const std::vector<Point>& points, float* pos, float* deriv);
 void cross(const float* a, const float* b, float* res);
 void normalize(float* v);
 void buildRotMatrix(const float* x, const float* y, const float* z, float* m);
@@ -0,0 +1,35 @@
+/**
+ * @file frameClock.cpp
+ * @brief Per-frame animation clock
+ */
+
+#include "frameClock.h"
+#include <chrono>
+
+double monotonicSeconds() {
+    typedef std::chrono::steady_clock Clock;
+    return std::chrono::duration<double>(Clock::now().time_since_epoch()).count();
+}
+
+void resetFrameClock(FrameClock& clock) {
+    clock.start = monotonicSeconds();
+    clock.realTime = clock.realDelta = 0.0;
+    clock.time = clock.delta = 0.0;
+    clock.frame = 0;
+}
+
+void tickFrameClock(FrameClock& clock) {
+    double now = monotonicSeconds() - clock.start;
+    clock.realDelta = now - clock.realTime;
+    clock.realTime = now;
+
+    if (clock.paused) {
+        clock.delta = 0.0;
+    } else if (clock.fixedStep > 0.0) {
+        clock.delta = clock.fixedStep;
+    } else {
+        clock.delta = clock.realDelta * clock.timeScale;
+    }
+    clock.time += clock.delta;
+    clock.frame++;
+}
@@ -0,0 +1,46 @@
+#ifndef FRAME_CLOCK_H
+#define FRAME_CLOCK_H
+
+#include <cstdint>
+
+/**
+ * @file frameClock.h
+ * @brief Per-frame animation clock
+ *
+ * The monotonic clock is read once per frame by tickFrameClock, and every
+ * animated transform of that frame is evaluated at the resulting time.
+ * Animation time can be paused and scaled, or advanced by a fixed step
+ * per frame regardless of the wall clock, which makes runs reproducible
+ * frame for frame (benchmarks, captures).
+ */
+
+struct FrameClock {
+    double realTime = 0.0;    // Wall-clock seconds since reset, at the last tick
+    double realDelta = 0.0;   // Wall-clock seconds between the last two ticks
+    double time = 0.0;        // Animation time in seconds, at the last tick
+    double delta = 0.0;       // Animation time advanced by the last tick
+    uint64_t frame = 0;       // Ticks since reset
+
+    double timeScale = 1.0;   // Animation seconds per wall-clock second
+    double fixedStep = 0.0;   // If > 0, animation seconds per tick instead (timeScale is ignored)
+    bool paused = false;      // Animation time stands still (the wall clock keeps running)
+
+    double start = 0.0;       // Monotonic clock reading at reset
+};
+
+// Seconds on a monotonic high-resolution clock (arbitrary origin)
+double monotonicSeconds();
+
+// Restarts wall-clock and animation time at zero, keeping the mode settings
+void resetFrameClock(FrameClock& clock);
+
+/**
+ * @brief Samples the monotonic clock and advances animation time
+ *
+ * Call once at the start of each frame.
+ *
+ * @param clock The clock
+ */
+void tickFrameClock(FrameClock& clock);
+
+#endif // FRAME_CLOCK_H
@@ -0,0 +1,78 @@
+/**
+ * @file frustum.cpp
+ * @brief View frustum culling of model bounds
+ */
+
+#include "frustum.h"
+#include "matrix.h"
+#include <cmath>
+
+namespace {
+
+// Signed distance from a plane to a point
+inline float planeDistance(const float* plane, const float* p) {
+    return plane[0] * p[0] + plane[1] * p[1] + plane[2] * p[2] + plane[3];
+}
+
+} // namespace
+
+void frustumFromProjection(const float* projection, Frustum& frustum) {
+    // Gribb/Hartmann: each plane is the last row of the matrix plus or minus another row
+    const float* m = projection;
+    for (int i = 0; i < 6; i++) {
+        int row = i / 2;
+        float sign = (i % 2 == 0) ? 1.0f : -1.0f;
+        float* plane = frustum.planes[i];
+        for (int col = 0; col < 4; col++) {
+            plane[col] = m[col * 4 + 3] + sign * m[col * 4 + row];
+        }
+        float length = std::sqrt(plane[0] * plane[0] + plane[1] * plane[1] + plane[2] * plane[2]);
+        if (length > 0) {
+            for (int col = 0; col < 4; col++) plane[col] /= length;
+        }
+    }
+}
+
+FrustumTest testSphere(const Frustum& frustum, const float* modelView, const float* center, float radius) {
+    float eyeCenter[3];
+    mat4TransformPoint(modelView, center, eyeCenter);
+    float eyeRadius = radius * mat4MaxScale(modelView);
+
+    FrustumTest result = FRUSTUM_INSIDE;
+    for (int i = 0; i < 6; i++) {
+        float distance = planeDistance(frustum.planes[i], eyeCenter);
+        if (distance < -eyeRadius) return FRUSTUM_OUTSIDE;
+        if (distance < eyeRadius) result = FRUSTUM_INTERSECTS;
+    }
+    return result;
+}
+
+bool isBoxVisible(const Frustum& frustum, const float* modelView, const float* boxMin, const float* boxMax) {
+    float center[3], halfExtent[3];
+    for (int k = 0; k < 3; k++) {
+        center[k] = (boxMin[k] + boxMax[k]) * 0.5f;
+        halfExtent[k] = (boxMax[k] - boxMin[k]) * 0.5f;
+    }
+    float eyeCenter[3];
+    mat4TransformPoint(modelView, center, eyeCenter);
+
+    for (int i = 0; i < 6; i++) {
+        const float* plane = frustum.planes[i];
+        // Projected half size of the box on the plane normal
+        float extent = 0;
+        for (int col = 0; col < 3; col++) {
+            const float* axis = modelView + col * 4;
+            extent += std::fabs(plane[0] * axis[0] + plane[1] * axis[1] + plane[2] * axis[2]) * halfExtent[col];
+        }
+        if (planeDistance(plane, eyeCenter) < -extent) return false;
+    }
+    return true;
+}
+
+bool isMeshVisible(const Frustum& frustum, const float* modelView, const Mesh& mesh) {
+    if (mesh.boundsRadius < 0) return true;
+
+    FrustumTest sphere = testSphere(frustum, modelView, mesh.boundsCenter, mesh.boundsRadius);
+    if (sphere != FRUSTUM_INTERSECTS) return sphere == FRUSTUM_INSIDE;
+    return isBoxVisible(frustum, modelView, mesh.boundsMin, mesh.boundsMax);
+}
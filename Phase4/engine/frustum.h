@@ -0,0 +1,73 @@
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#include "engine.h"
+
+/**
+ * @file frustum.h
+ * @brief View frustum culling of model bounds
+ *
+ * The planes are taken from the projection matrix, so they live in eye
+ * space and only change with the window or the camera's field of view.
+ * Bounds are brought into eye space with the model-view matrices the
+ * scene already caches, so testing a model costs no extra matrix work.
+ */
+
+// Six planes (left, right, bottom, top, near, far) as ax + by + cz + d >= 0 inside
+struct Frustum {
+    float planes[6][4];
+};
+
+// Result of testing bounds against a frustum
+enum FrustumTest {
+    FRUSTUM_OUTSIDE,
+    FRUSTUM_INTERSECTS,
+    FRUSTUM_INSIDE
+};
+
+/**
+ * @brief Extracts the eye-space frustum planes of a projection matrix
+ *
+ * @param projection Column-major projection matrix
+ * @param frustum Receives the normalized planes
+ */
+void frustumFromProjection(const float* projection, Frustum& frustum);
+
+/**
+ * @brief Tests a bounding sphere placed by a matrix
+ *
+ * The matrix may scale; the radius grows by its largest axis scale.
+ *
+ * @param frustum Eye-space frustum
+ * @param modelView Matrix from the sphere's space to eye space
+ * @param center Sphere centre
+ * @param radius Sphere radius
+ * @return Whether the sphere is outside, crosses a plane or is fully inside
+ */
+FrustumTest testSphere(const Frustum& frustum, const float* modelView, const float* center, float radius);
+
+/**
+ * @brief Tests an axis-aligned box placed by a matrix (an oriented box in eye space)
+ *
+ * @param frustum Eye-space frustum
+ * @param modelView Matrix from the box's space to eye space
+ * @param boxMin Minimum corner
+ * @param boxMax Maximum corner
+ * @return False only if the box is entirely outside one plane
+ */
+bool isBoxVisible(const Frustum& frustum, const float* modelView, const float* boxMin, const float* boxMax);
+
+/**
+ * @brief Tests whether a mesh may be visible
+ *
+ * The bounding sphere answers most cases; the box refines the spheres
+ * that cross a plane. Meshes without bounds count as visible.
+ *
+ * @param frustum Eye-space frustum
+ * @param modelView Model-view matrix of the model
+ * @param mesh The model's mesh
+ * @return False if the mesh is certainly off screen
+ */
+bool isMeshVisible(const Frustum& frustum, const float* modelView, const Mesh& mesh);
+
+#endif // FRUSTUM_H
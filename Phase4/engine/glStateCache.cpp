@@ -0,0 +1,209 @@
+/**
+ * @file glStateCache.cpp
+ * @brief Shadow copy of the GL state the engine changes, to drop redundant calls
+ */
+
+#include "glStateCache.h"
+#ifdef __APPLE__
+#include <OpenGL/gl.h>
+#else
+#include <GL/gl.h>
+#endif
+#include <cstring>
+
+namespace {
+
+// Shadow of a boolean state: unknown until first set or queried
+enum Tristate : signed char { STATE_UNKNOWN = -1, STATE_OFF = 0, STATE_ON = 1 };
+
+// Shadow of an object binding
+struct CachedBinding {
+    bool known = false;
+    GLuint name = 0;
+};
+
+// Capabilities with a shadow copy; others always go to GL
+struct CachedCap {
+    GLenum cap;
+    Tristate state;
+};
+CachedCap caps[] = {
+    {GL_LIGHTING, STATE_UNKNOWN},
+    {GL_TEXTURE_2D, STATE_UNKNOWN},
+    {GL_COLOR_MATERIAL, STATE_UNKNOWN},
+    {GL_DEPTH_TEST, STATE_UNKNOWN},
+    {GL_CULL_FACE, STATE_UNKNOWN},
+    {GL_NORMALIZE, STATE_UNKNOWN},
+    {GL_LIGHT0, STATE_UNKNOWN}, {GL_LIGHT1, STATE_UNKNOWN},
+    {GL_LIGHT2, STATE_UNKNOWN}, {GL_LIGHT3, STATE_UNKNOWN},
+    {GL_LIGHT4, STATE_UNKNOWN}, {GL_LIGHT5, STATE_UNKNOWN},
+    {GL_LIGHT6, STATE_UNKNOWN}, {GL_LIGHT7, STATE_UNKNOWN},
+};
+
+// Client arrays of the bound vertex array object
+const GLenum clientArrays[] = {GL_VERTEX_ARRAY, GL_NORMAL_ARRAY, GL_TEXTURE_COORD_ARRAY};
+Tristate clientArrayState[] = {STATE_UNKNOWN, STATE_UNKNOWN, STATE_UNKNOWN};
+
+CachedBinding texture2D;
+CachedBinding arrayBuffer;
+CachedBinding elementBuffer;    // Part of the vertex array object
+CachedBinding vertexArray;
+
+// Front material: diffuse, ambient, specular, emission, shininess
+const GLenum materialParams[] = {GL_DIFFUSE, GL_AMBIENT, GL_SPECULAR, GL_EMISSION, GL_SHININESS};
+bool materialKnown[5] = {false, false, false, false, false};
+float materialValues[5][4];
+
+GLStateCacheStats stats;
+
+Tristate* findCap(GLenum cap) {
+    for (CachedCap& c : caps) {
+        if (c.cap == cap) return &c.state;
+    }
+    return nullptr;
+}
+
+// Whether a binding is already current; records it as current either way
+bool sameBinding(CachedBinding& binding, GLuint name) {
+    if (binding.known && binding.name == name) {
+        stats.filtered++;
+        return true;
+    }
+    binding.known = true;
+    binding.name = name;
+    stats.issued++;
+    return false;
+}
+
+void forgetBinding(CachedBinding& binding, GLuint name) {
+    if (binding.known && binding.name == name) binding.name = 0;
+}
+
+} // namespace
+
+void cachedEnable(GLenum cap, bool enabled) {
+    Tristate* state = findCap(cap);
+    Tristate wanted = enabled ? STATE_ON : STATE_OFF;
+    if (state && *state == wanted) {
+        stats.filtered++;
+        return;
+    }
+    if (enabled) {
+        glEnable(cap);
+    } else {
+        glDisable(cap);
+    }
+    if (state) *state = wanted;
+    stats.issued++;
+
+    // glColor changes the material while color material is on
+    if (cap == GL_COLOR_MATERIAL && enabled) {
+        std::memset(materialKnown, 0, sizeof(materialKnown));
+    }
+}
+
+bool cachedIsEnabled(GLenum cap) {
+    Tristate* state = findCap(cap);
+    if (state && *state != STATE_UNKNOWN) {
+        stats.filtered++;
+        return *state == STATE_ON;
+    }
+    bool enabled = glIsEnabled(cap) == GL_TRUE;
+    if (state) *state = enabled ? STATE_ON : STATE_OFF;
+    stats.issued++;
+    return enabled;
+}
+
+void cachedClientState(GLenum array, bool enabled) {
+    Tristate* state = nullptr;
+    for (int i = 0; i < 3; i++) {
+        if (clientArrays[i] == array) state = &clientArrayState[i];
+    }
+    Tristate wanted = enabled ? STATE_ON : STATE_OFF;
+    if (state && *state == wanted) {
+        stats.filtered++;
+        return;
+    }
+    if (enabled) {
+        glEnableClientState(array);
+    } else {
+        glDisableClientState(array);
+    }
+    if (state) *state = wanted;
+    stats.issued++;
+}
+
+void cachedBindTexture(GLuint texture) {
+    if (sameBinding(texture2D, texture)) return;
+    glBindTexture(GL_TEXTURE_2D, texture);
+}
+
+void cachedBindBuffer(GLenum target, GLuint buffer) {
+    CachedBinding* binding = target == GL_ARRAY_BUFFER ? &arrayBuffer
+                           : target == GL_ELEMENT_ARRAY_BUFFER ? &elementBuffer : nullptr;
+    if (!binding) {
+        glBindBuffer(target, buffer);
+        stats.issued++;
+        return;
+    }
+    if (sameBinding(*binding, buffer)) return;
+    glBindBuffer(target, buffer);
+}
+
+void cachedBindVertexArray(GLuint vao) {
+    if (sameBinding(vertexArray, vao)) return;
+    glBindVertexArray(vao);
+    elementBuffer.known = false;
+    for (Tristate& state : clientArrayState) state = STATE_UNKNOWN;
+}
+
+void cachedMaterial(GLenum pname, const float* values) {
+    int index = -1;
+    for (int i = 0; i < 5; i++) {
+        if (materialParams[i] == pname) index = i;
+    }
+    int count = pname == GL_SHININESS ? 1 : 4;
+    Tristate* colorMaterial = findCap(GL_COLOR_MATERIAL);
+    bool trackable = index >= 0 && *colorMaterial == STATE_OFF;
+    if (trackable && materialKnown[index] &&
+        std::memcmp(materialValues[index], values, count * sizeof(float)) == 0) {
+        stats.filtered++;
+        return;
+    }
+    if (count == 1) {
+        glMaterialf(GL_FRONT, pname, values[0]);
+    } else {
+        glMaterialfv(GL_FRONT, pname, values);
+    }
+    stats.issued++;
+    if (trackable) {
+        std::memcpy(materialValues[index], values, count * sizeof(float));
+        materialKnown[index] = true;
+    }
+}
+
+void forgetCachedTexture(GLuint texture) {
+    forgetBinding(texture2D, texture);
+}
+
+void forgetCachedBuffer(GLuint buffer) {
+    forgetBinding(arrayBuffer, buffer);
+    forgetBinding(elementBuffer, buffer);
+}
+
+void forgetCachedVertexArray(GLuint vao) {
+    if (vertexArray.known && vertexArray.name == vao) {
+        // Deleting the bound vertex array object binds the default one
+        vertexArray.name = 0;
+        elementBuffer.known = false;
+        for (Tristate& state : clientArrayState) state = STATE_UNKNOWN;
+    }
+}
+
+GLStateCacheStats getGLStateCacheStats() {
+    return stats;
+}
+
+void resetGLStateCacheStats() {
+    stats = GLStateCacheStats();
+}
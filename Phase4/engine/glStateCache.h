@@ -0,0 +1,80 @@
+#ifndef GL_STATE_CACHE_H
+#define GL_STATE_CACHE_H
+
+#include <cstddef>
+
+#ifdef __APPLE__
+#include <OpenGL/gl3.h>
+#else
+#include <GL/glew.h>
+#endif
+
+/**
+ * @file glStateCache.h
+ * @brief Shadow copy of the GL state the engine changes, to drop redundant calls
+ *
+ * Capability enables, client-side vertex arrays, texture and buffer
+ * bindings, the bound vertex array object and the front material are
+ * remembered on the CPU. A call that would set a value that is already
+ * current is not passed to the driver, and queries are answered from the
+ * copy, so neither costs a driver round trip.
+ *
+ * The copy starts unknown: the first call for each piece of state always
+ * goes through (and the first query asks GL). Engine code must change the
+ * tracked state only through these functions, and report deleted objects
+ * with the forget functions. Only texture unit 0 and GL_FRONT materials
+ * are tracked.
+ */
+
+// Calls passed to GL and calls dropped as redundant
+struct GLStateCacheStats {
+    size_t issued = 0;
+    size_t filtered = 0;
+};
+
+// glEnable / glDisable
+void cachedEnable(GLenum cap, bool enabled);
+
+// glIsEnabled, answered from the shadow copy once known
+bool cachedIsEnabled(GLenum cap);
+
+// glEnableClientState / glDisableClientState (vertex, normal and texture coordinate arrays)
+void cachedClientState(GLenum array, bool enabled);
+
+// glBindTexture(GL_TEXTURE_2D, texture) on texture unit 0
+void cachedBindTexture(GLuint texture);
+
+// glBindBuffer for GL_ARRAY_BUFFER or GL_ELEMENT_ARRAY_BUFFER
+void cachedBindBuffer(GLenum target, GLuint buffer);
+
+/**
+ * @brief glBindVertexArray
+ *
+ * The element buffer and client arrays belong to the vertex array object,
+ * so they become unknown when a different one is bound.
+ *
+ * @param vao Vertex array object (0 for the default)
+ */
+void cachedBindVertexArray(GLuint vao);
+
+/**
+ * @brief glMaterialfv(GL_FRONT, ...) / glMaterialf(GL_FRONT, GL_SHININESS, ...)
+ *
+ * Always passed through while GL_COLOR_MATERIAL may be enabled, since
+ * glColor then changes the material behind the cache's back.
+ *
+ * @param pname GL_DIFFUSE, GL_AMBIENT, GL_SPECULAR, GL_EMISSION or GL_SHININESS
+ * @param values 4 values (1 for GL_SHININESS)
+ */
+void cachedMaterial(GLenum pname, const float* values);
+
+// Call after deleting GL objects, which unbinds them if they were bound
+void forgetCachedTexture(GLuint texture);
+void forgetCachedBuffer(GLuint buffer);
+void forgetCachedVertexArray(GLuint vao);
+
+// Counters since the last reset (the engine resets them every frame)
+GLStateCacheStats getGLStateCacheStats();
+void resetGLStateCacheStats();
+
+#endif // GL_STATE_CACHE_H
@@ -0,0 +1,429 @@
+/**
+ * @file instancing.cpp
+ * @brief Instanced rendering of models that share a mesh and a texture
+ */
+
+#include "instancing.h"
+#include "glStateCache.h"
+#include "lod.h"
+#include "scene.h"
+#include "texture.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <utility>
+#include <vector>
+
+#ifdef __APPLE__
+
+bool initInstancing() {
+    return false;
+}
+
+void invalidateInstanceBatches() {
+}
+
+RenderStateStats drawInstancedModels(Scene&, int) {
+    return RenderStateStats();
+}
+
+#else
+
+namespace {
+
+// Generic attribute locations (built-in attributes are not used so that
+// nothing aliases with the instance attributes on any driver)
+enum {
+    ATTRIB_POSITION = 0,
+    ATTRIB_NORMAL = 1,
+    ATTRIB_TEXCOORD = 2,
+    ATTRIB_MODELVIEW = 3,   // 4 columns: 3..6
+    ATTRIB_DIFFUSE = 7,     // rgb + shininess
+    ATTRIB_AMBIENT = 8,
+    ATTRIB_SPECULAR = 9,
+    ATTRIB_EMISSIVE = 10,
+    ATTRIB_LAST = 10
+};
+
+// One instance in the instance buffer: model-view matrix + material, 128 bytes
+const int INSTANCE_FLOATS = 32;
+
+// Per-vertex lighting equivalent to the fixed-function pipeline with
+// GL_LIGHT_MODEL_LOCAL_VIEWER, reading lights from the built-in GL state
+const char* vertexShaderSource =
+    "#version 120\n"
+    "attribute vec3 position;\n"
+    "attribute vec3 normal;\n"
+    "attribute vec2 texCoord;\n"
+    "attribute vec4 modelView0;\n"
+    "attribute vec4 modelView1;\n"
+    "attribute vec4 modelView2;\n"
+    "attribute vec4 modelView3;\n"
+    "attribute vec4 diffuse;\n"
+    "attribute vec4 ambient;\n"
+    "attribute vec4 specular;\n"
+    "attribute vec4 emissive;\n"
+    "uniform int lightCount;\n"
+    "uniform vec4 unlitColor;\n"
+    "uniform vec4 positionTransform;\n"   // Dequantization: offset (xyz) and scale (w)
+    "varying vec4 color;\n"
+    "varying vec2 uv;\n"
+    "void main() {\n"
+    "    mat4 modelView = mat4(modelView0, modelView1, modelView2, modelView3);\n"
+    "    vec4 eye = modelView * vec4(positionTransform.xyz + position * positionTransform.w, 1.0);\n"
+    "    gl_Position = gl_ProjectionMatrix * eye;\n"
+    "    uv = texCoord;\n"
+    "    if (lightCount == 0) {\n"
+    "        color = unlitColor;\n"
+    "        return;\n"
+    "    }\n"
+    "    // The cofactor matrix is the inverse transpose up to a scale factor\n"
+    "    vec3 c0 = modelView0.xyz, c1 = modelView1.xyz, c2 = modelView2.xyz;\n"
+    "    vec3 n = mat3(cross(c1, c2), cross(c2, c0), cross(c0, c1)) * normal;\n"
+    "    n = normalize(n * sign(dot(c0, cross(c1, c2))));\n"
+    "    vec3 v = normalize(-eye.xyz);\n"
+    "    vec3 lit = emissive.rgb + ambient.rgb * gl_LightModel.ambient.rgb;\n"
+    "    for (int i = 0; i < 8; i++) {\n"
+    "        if (i >= lightCount) break;\n"
+    "        vec3 l;\n"
+    "        float attenuation = 1.0;\n"
+    "        if (gl_LightSource[i].position.w == 0.0) {\n"
+    "            l = normalize(gl_LightSource[i].position.xyz);\n"
+    "        } else {\n"
+    "            vec3 toLight = gl_LightSource[i].position.xyz - eye.xyz;\n"
+    "            float d = length(toLight);\n"
+    "            l = toLight / d;\n"
+    "            attenuation = 1.0 / (gl_LightSource[i].constantAttenuation +\n"
+    "                                 gl_LightSource[i].linearAttenuation * d +\n"
+    "                                 gl_LightSource[i].quadraticAttenuation * d * d);\n"
+    "            if (gl_LightSource[i].spotCutoff <= 90.0) {\n"
+    "                float spot = dot(-l, normalize(gl_LightSource[i].spotDirection));\n"
+    "                attenuation *= spot < gl_LightSource[i].spotCosCutoff ? 0.0\n"
+    "                             : pow(spot, gl_LightSource[i].spotExponent);\n"
+    "            }\n"
+    "        }\n"
+    "        float nDotL = max(dot(n, l), 0.0);\n"
+    "        vec3 term = ambient.rgb * gl_LightSource[i].ambient.rgb +\n"
+    "                    nDotL * diffuse.rgb * gl_LightSource[i].diffuse.rgb;\n"
+    "        if (nDotL > 0.0) {\n"
+    "            float nDotH = max(dot(n, normalize(l + v)), 0.0);\n"
+    "            term += pow(nDotH, diffuse.w) * specular.rgb * gl_LightSource[i].specular.rgb;\n"
+    "        }\n"
+    "        lit += attenuation * term;\n"
+    "    }\n"
+    "    color = vec4(clamp(lit, 0.0, 1.0), 1.0);\n"
+    "}\n";
+
+const char* fragmentShaderSource =
+    "#version 120\n"
+    "uniform sampler2D diffuseMap;\n"
+    "uniform bool useTexture;\n"
+    "varying vec4 color;\n"
+    "varying vec2 uv;\n"
+    "void main() {\n"
+    "    gl_FragColor = useTexture ? color * texture2D(diffuseMap, uv) : color;\n"
+    "}\n";
+
+// Models drawn with one instanced call
+struct InstanceBatch {
+    const Mesh* mesh = nullptr;
+    GLuint texture = 0;              // 0 if drawn untextured
+    std::vector<unsigned> nodes;     // Node of each instance (for its model-view matrix)
+    std::vector<unsigned> models;    // Model of each instance (for its frustum test result)
+    std::vector<float> materials;    // 16 floats of material per instance
+    std::vector<size_t> levelCounts; // Instances gathered this frame per level of detail
+};
+
+GLuint program = 0;
+GLint lightCountLocation = -1;
+GLint unlitColorLocation = -1;
+GLint useTextureLocation = -1;
+GLint positionTransformLocation = -1;
+GLuint instanceBuffer = 0;
+
+std::vector<InstanceBatch> batches;
+bool batchesValid = false;
+std::vector<float> instanceData;
+
+GLuint compileShader(GLenum type, const char* source) {
+    GLuint shader = glCreateShader(type);
+    glShaderSource(shader, 1, &source, nullptr);
+    glCompileShader(shader);
+
+    GLint compiled = GL_FALSE;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
+    if (!compiled) {
+        char log[1024];
+        glGetShaderInfoLog(shader, sizeof(log), nullptr, log);
+        std::cerr << "Instancing shader failed to compile: " << log << std::endl;
+        glDeleteShader(shader);
+        return 0;
+    }
+    return shader;
+}
+
+// Material of a model as four vec4s, with the same defaults as the render queue (applyMaterial)
+void packMaterial(const Material& material, float* out) {
+    bool hasDefinedMaterial = (material.diffuse.r > 0 || material.diffuse.g > 0 || material.diffuse.b > 0 ||
+                               material.ambient.r > 0 || material.ambient.g > 0 || material.ambient.b > 0);
+    if (hasDefinedMaterial) {
+        float packed[16] = {
+            material.diffuse.r, material.diffuse.g, material.diffuse.b, material.shininess,
+            material.ambient.r, material.ambient.g, material.ambient.b, 1.0f,
+            material.specular.r, material.specular.g, material.specular.b, 1.0f,
+            material.emissive.r, material.emissive.g, material.emissive.b, 1.0f
+        };
+        std::memcpy(out, packed, sizeof(packed));
+    } else {
+        float packed[16] = {
+            1.0f, 1.0f, 1.0f, 0.0f,
+            0.2f, 0.2f, 0.2f, 1.0f,
+            0.0f, 0.0f, 0.0f, 1.0f,
+            0.0f, 0.0f, 0.0f, 1.0f
+        };
+        std::memcpy(out, packed, sizeof(packed));
+    }
+}
+
+// Groups the drawable models of the scene by (mesh, texture), ordered by texture
+void buildBatches(const Scene& scene) {
+    batches.clear();
+    std::map<std::pair<const Mesh*, GLuint>, size_t> batchIndex;
+
+    for (size_t i = 0; i < scene.nodes.size(); i++) {
+        const SceneNode& node = scene.nodes[i];
+        for (unsigned m = node.firstModel; m < node.firstModel + node.modelCount; m++) {
+            const Model& model = scene.models[m];
+            if (!model.mesh || model.mesh->vertexCount == 0) continue;
+
+            GLuint texture = 0;
+            if (model.textureID > 0 && !model.textureFile.empty() && isTextureReady(model.textureID)) {
+                texture = model.textureID;
+            }
+
+            std::pair<const Mesh*, GLuint> key(model.mesh, texture);
+            auto it = batchIndex.find(key);
+            if (it == batchIndex.end()) {
+                it = batchIndex.insert(std::make_pair(key, batches.size())).first;
+                batches.push_back(InstanceBatch());
+                batches.back().mesh = model.mesh;
+                batches.back().texture = texture;
+            }
+
+            InstanceBatch& batch = batches[it->second];
+            batch.nodes.push_back(static_cast<unsigned>(i));
+            batch.models.push_back(m);
+            batch.materials.resize(batch.materials.size() + 16);
+            packMaterial(scene.materials[m], &batch.materials[batch.materials.size() - 16]);
+        }
+    }
+
+    // Batches sharing a texture are drawn one after another, so each texture is bound once
+    std::stable_sort(batches.begin(), batches.end(), [](const InstanceBatch& a, const InstanceBatch& b) {
+        return a.texture < b.texture;
+    });
+    batchesValid = true;
+}
+
+// Points the instance attributes at a batch's range of the instance buffer
+void bindInstanceAttributes(size_t firstInstance) {
+    const GLsizei stride = INSTANCE_FLOATS * sizeof(float);
+    const char* base = reinterpret_cast<const char*>(firstInstance * stride);
+    for (int i = 0; i < 8; i++) {
+        glVertexAttribPointer(ATTRIB_MODELVIEW + i, 4, GL_FLOAT, GL_FALSE, stride, base + i * 4 * sizeof(float));
+    }
+}
+
+} // namespace
+
+bool initInstancing() {
+    if (!GLEW_VERSION_2_0 || !GLEW_ARB_instanced_arrays || !GLEW_ARB_draw_instanced) {
+        std::cout << "Instanced rendering not supported, drawing models one by one" << std::endl;
+        return false;
+    }
+
+    GLuint vertexShader = compileShader(GL_VERTEX_SHADER, vertexShaderSource);
+    GLuint fragmentShader = compileShader(GL_FRAGMENT_SHADER, fragmentShaderSource);
+    if (!vertexShader || !fragmentShader) {
+        if (vertexShader) glDeleteShader(vertexShader);
+        if (fragmentShader) glDeleteShader(fragmentShader);
+        return false;
+    }
+
+    program = glCreateProgram();
+    glAttachShader(program, vertexShader);
+    glAttachShader(program, fragmentShader);
+    glBindAttribLocation(program, ATTRIB_POSITION, "position");
+    glBindAttribLocation(program, ATTRIB_NORMAL, "normal");
+    glBindAttribLocation(program, ATTRIB_TEXCOORD, "texCoord");
+    glBindAttribLocation(program, ATTRIB_MODELVIEW + 0, "modelView0");
+    glBindAttribLocation(program, ATTRIB_MODELVIEW + 1, "modelView1");
+    glBindAttribLocation(program, ATTRIB_MODELVIEW + 2, "modelView2");
+    glBindAttribLocation(program, ATTRIB_MODELVIEW + 3, "modelView3");
+    glBindAttribLocation(program, ATTRIB_DIFFUSE, "diffuse");
+    glBindAttribLocation(program, ATTRIB_AMBIENT, "ambient");
+    glBindAttribLocation(program, ATTRIB_SPECULAR, "specular");
+    glBindAttribLocation(program, ATTRIB_EMISSIVE, "emissive");
+    glLinkProgram(program);
+    glDeleteShader(vertexShader);
+    glDeleteShader(fragmentShader);
+
+    GLint linked = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &linked);
+    if (!linked) {
+        char log[1024];
+        glGetProgramInfoLog(program, sizeof(log), nullptr, log);
+        std::cerr << "Instancing shader failed to link: " << log << std::endl;
+        glDeleteProgram(program);
+        program = 0;
+        return false;
+    }
+
+    lightCountLocation = glGetUniformLocation(program, "lightCount");
+    unlitColorLocation = glGetUniformLocation(program, "unlitColor");
+    useTextureLocation = glGetUniformLocation(program, "useTexture");
+    positionTransformLocation = glGetUniformLocation(program, "positionTransform");
+    glUseProgram(program);
+    glUniform1i(glGetUniformLocation(program, "diffuseMap"), 0);
+    glUseProgram(0);
+
+    glGenBuffers(1, &instanceBuffer);
+    std::cout << "Instanced rendering enabled" << std::endl;
+    return true;
+}
+
+void invalidateInstanceBatches() {
+    batchesValid = false;
+}
+
+RenderStateStats drawInstancedModels(Scene& scene, int lightCount) {
+    RenderStateStats stats;
+    if (!program) return stats;
+    if (!batchesValid) buildBatches(scene);
+    if (batches.empty()) return stats;
+
+    // Gather the visible instances of all batches into one buffer upload,
+    // grouped by level of detail within each batch
+    size_t instanceCount = 0;
+    for (const InstanceBatch& batch : batches) instanceCount += batch.nodes.size();
+    instanceData.resize(instanceCount * INSTANCE_FLOATS);
+    float* out = instanceData.data();
+    for (InstanceBatch& batch : batches) {
+        batch.levelCounts.assign(meshLevelCount(*batch.mesh), 0);
+        for (size_t k = 0; k < batch.nodes.size(); k++) {
+            unsigned model = batch.models[k];
+            if (scene.modelVisible[model]) {
+                batch.levelCounts[std::min<size_t>(scene.modelLod[model], batch.levelCounts.size() - 1)]++;
+            }
+        }
+        std::vector<float*> levelOut(batch.levelCounts.size());
+        for (size_t level = 0; level < batch.levelCounts.size(); level++) {
+            levelOut[level] = out;
+            out += batch.levelCounts[level] * INSTANCE_FLOATS;
+        }
+        for (size_t k = 0; k < batch.nodes.size(); k++) {
+            unsigned model = batch.models[k];
+            if (!scene.modelVisible[model]) continue;
+            float*& instance = levelOut[std::min<size_t>(scene.modelLod[model], levelOut.size() - 1)];
+            std::memcpy(instance, modelViewMatrix(scene, batch.nodes[k]), 16 * sizeof(float));
+            std::memcpy(instance + 16, &batch.materials[k * 16], 16 * sizeof(float));
+            instance += INSTANCE_FLOATS;
+        }
+    }
+    size_t usedFloats = static_cast<size_t>(out - instanceData.data());
+    if (usedFloats == 0) return stats;
+    cachedBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+    glBufferData(GL_ARRAY_BUFFER, usedFloats * sizeof(float), instanceData.data(), GL_STREAM_DRAW);
+
+    float unlitColor[4];
+    glGetFloatv(GL_CURRENT_COLOR, unlitColor);
+    glUseProgram(program);
+    stats.programChanges++;
+    glUniform1i(lightCountLocation, lightCount);
+    glUniform4fv(unlitColorLocation, 1, unlitColor);
+
+    for (int i = ATTRIB_MODELVIEW; i <= ATTRIB_LAST; i++) {
+        glEnableVertexAttribArray(i);
+        glVertexAttribDivisorARB(i, 1);
+    }
+    glEnableVertexAttribArray(ATTRIB_POSITION);
+    glActiveTexture(GL_TEXTURE0);
+
+    GLuint currentTexture = 0;
+    const Mesh* currentMesh = nullptr;
+    size_t firstInstance = 0;
+    for (const InstanceBatch& batch : batches) {
+        for (size_t level = 0; level < batch.levelCounts.size(); level++) {
+            if (batch.levelCounts[level] == 0) continue;
+            const Mesh* mesh = &meshLevel(*batch.mesh, static_cast<unsigned>(level));
+
+            cachedBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+            bindInstanceAttributes(firstInstance);
+
+            // Position, normal and texture coordinates all come from the mesh's one vertex buffer
+            cachedBindBuffer(GL_ARRAY_BUFFER, mesh->vbo);
+            if (mesh != currentMesh) {
+                currentMesh = mesh;
+                stats.meshChanges++;
+            }
+            glVertexAttribPointer(ATTRIB_POSITION, 3, mesh->positionType, GL_FALSE, mesh->vertexStride, 0);
+            glUniform4f(positionTransformLocation, mesh->positionOffset[0], mesh->positionOffset[1],
+                        mesh->positionOffset[2], mesh->positionScale);
+
+            if (mesh->normalOffset >= 0) {
+                glEnableVertexAttribArray(ATTRIB_NORMAL);
+                // Packed 10:10:10:2 normals are always read as 4 normalized components
+                bool packedNormal = mesh->normalType == GL_INT_2_10_10_10_REV;
+                glVertexAttribPointer(ATTRIB_NORMAL, packedNormal ? 4 : 3, mesh->normalType,
+                                      packedNormal ? GL_TRUE : GL_FALSE, mesh->vertexStride,
+                                      reinterpret_cast<const void*>(mesh->normalOffset));
+            } else {
+                // No normals available - use a default normal
+                glDisableVertexAttribArray(ATTRIB_NORMAL);
+                glVertexAttrib3f(ATTRIB_NORMAL, 0.0f, 1.0f, 0.0f);
+            }
+
+            bool textured = batch.texture != 0 && mesh->texCoordOffset >= 0;
+            if (textured) {
+                glEnableVertexAttribArray(ATTRIB_TEXCOORD);
+                glVertexAttribPointer(ATTRIB_TEXCOORD, 2, mesh->texCoordType, GL_FALSE, mesh->vertexStride,
+                                      reinterpret_cast<const void*>(mesh->texCoordOffset));
+                if (batch.texture != currentTexture) {
+                    cachedBindTexture(batch.texture);
+                    currentTexture = batch.texture;
+                    stats.textureChanges++;
+                }
+            } else {
+                glDisableVertexAttribArray(ATTRIB_TEXCOORD);
+            }
+            glUniform1i(useTextureLocation, textured ? 1 : 0);
+
+            GLsizei instanceCount = static_cast<GLsizei>(batch.levelCounts[level]);
+            if (mesh->ibo != 0) {
+                cachedBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh->ibo);
+                glDrawElementsInstancedARB(GL_TRIANGLES, mesh->indexCount, GL_UNSIGNED_INT, 0, instanceCount);
+            } else {
+                glDrawArraysInstancedARB(GL_TRIANGLES, 0, mesh->vertexCount, instanceCount);
+            }
+            stats.draws++;
+            firstInstance += batch.levelCounts[level];
+        }
+    }
+
+    // Leave the fixed-function state as the rest of the frame expects it
+    for (int i = ATTRIB_MODELVIEW; i <= ATTRIB_LAST; i++) {
+        glVertexAttribDivisorARB(i, 0);
+        glDisableVertexAttribArray(i);
+    }
+    glDisableVertexAttribArray(ATTRIB_POSITION);
+    glDisableVertexAttribArray(ATTRIB_NORMAL);
+    glDisableVertexAttribArray(ATTRIB_TEXCOORD);
+    cachedBindBuffer(GL_ARRAY_BUFFER, 0);
+    cachedBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    cachedBindTexture(0);
+    glUseProgram(0);
+    return stats;
+}
+
+#endif
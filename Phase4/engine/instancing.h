@@ -0,0 +1,51 @@
+#ifndef INSTANCING_H
+#define INSTANCING_H
+
+#include "engine.h"
+#include "renderQueue.h"
+
+/**
+ * @file instancing.h
+ * @brief Instanced rendering of models that share a mesh and a texture
+ *
+ * Models are grouped into batches by (mesh, texture). Each batch is drawn
+ * with one glDrawArraysInstanced (or glDrawElementsInstanced) call per
+ * level of detail its visible models use; the per-instance model-view matrix
+ * and material come from an instance buffer and feed a GLSL 1.20 shader
+ * that reproduces the fixed-function per-vertex lighting.
+ *
+ * Needs ARB_instanced_arrays and ARB_draw_instanced (not used on Apple);
+ * without them the engine keeps drawing one model at a time.
+ */
+
+/**
+ * @brief Checks for the required extensions and compiles the shader
+ *
+ * Call once after glewInit.
+ *
+ * @return True if instanced rendering can be used
+ */
+bool initInstancing();
+
+/**
+ * @brief Drops the batches so they are rebuilt on the next draw
+ *
+ * Needed whenever a mesh or texture finishes loading, since that changes
+ * which models can be drawn and how they group.
+ */
+void invalidateInstanceBatches();
+
+/**
+ * @brief Draws every visible model of the scene in instanced batches
+ *
+ * Uses the model-view matrices, frustum test results and levels of detail
+ * cached in the scene, so they must be up to date for this frame. Batches with no
+ * visible instance issue no draw call. Lighting comes from the current GL light state.
+ *
+ * @param scene The scene
+ * @param lightCount Number of enabled lights (GL_LIGHT0 onwards), 0 for unlit
+ * @return Draw calls issued and state changes made (batches are ordered by texture)
+ */
+RenderStateStats drawInstancedModels(Scene& scene, int lightCount);
+
+#endif // INSTANCING_H
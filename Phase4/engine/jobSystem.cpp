@@ -0,0 +1,188 @@
+/**
+ * @file jobSystem.cpp
+ * @brief Worker pool and lock-free upload queue
+ */
+
+#include "jobSystem.h"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdlib>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// Worker pool state
+std::vector<std::thread> workers;
+std::deque<Job> jobs;
+std::mutex jobMutex;
+std::condition_variable jobReady;
+bool stopping = false;
+
+// Node of the upload queue
+struct UploadNode {
+    Upload upload;
+    UploadNode* next;
+};
+
+// Uploads posted by workers, newest first (Treiber stack: workers push,
+// the GLUT thread takes the whole list at once, so there is no ABA problem)
+std::atomic<UploadNode*> postedUploads(nullptr);
+
+// Uploads taken from the stack but not run yet, oldest first (GLUT thread only)
+std::deque<Upload> pendingUploads;
+
+void workerLoop() {
+    for (;;) {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(jobMutex);
+            jobReady.wait(lock, [] { return stopping || !jobs.empty(); });
+            if (stopping) return;
+            job = std::move(jobs.front());
+            jobs.pop_front();
+        }
+        job();
+    }
+}
+
+} // namespace
+
+void startJobWorkers(unsigned workerCount) {
+    if (!workers.empty()) return;
+
+    if (workerCount == 0) {
+        unsigned hardwareThreads = std::thread::hardware_concurrency();
+        workerCount = std::max(1u, hardwareThreads > 1 ? hardwareThreads - 1 : 1u);
+    }
+
+    static bool exitHandlerRegistered = false;
+    if (!exitHandlerRegistered) {
+        std::atexit(stopJobWorkers);
+        exitHandlerRegistered = true;
+    }
+
+    stopping = false;
+    for (unsigned i = 0; i < workerCount; i++) {
+        workers.emplace_back(workerLoop);
+    }
+}
+
+void stopJobWorkers() {
+    {
+        std::lock_guard<std::mutex> lock(jobMutex);
+        stopping = true;
+        jobs.clear();
+    }
+    jobReady.notify_all();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    workers.clear();
+}
+
+void submitJob(Job job) {
+    if (workers.empty()) {
+        job();
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(jobMutex);
+        jobs.push_back(std::move(job));
+    }
+    jobReady.notify_one();
+}
+
+namespace {
+
+// Progress of one parallelFor, shared with helper jobs that may start after it returned
+struct ParallelForState {
+    const std::function<void(size_t)>* task;
+    size_t count;
+    std::atomic<size_t> next;
+    std::atomic<size_t> done;
+    std::mutex mutex;
+    std::condition_variable finished;
+};
+
+// Takes indices until none are left; the task is only touched while one is outstanding
+void runParallelFor(ParallelForState& state) {
+    size_t index;
+    while ((index = state.next.fetch_add(1)) < state.count) {
+        (*state.task)(index);
+        if (state.done.fetch_add(1) + 1 == state.count) {
+            std::lock_guard<std::mutex> lock(state.mutex);
+            state.finished.notify_all();
+        }
+    }
+}
+
+} // namespace
+
+void parallelFor(size_t count, const std::function<void(size_t)>& task) {
+    if (workers.empty() || count < 2) {
+        for (size_t i = 0; i < count; i++) task(i);
+        return;
+    }
+
+    std::shared_ptr<ParallelForState> state = std::make_shared<ParallelForState>();
+    state->task = &task;
+    state->count = count;
+    state->next = 0;
+    state->done = 0;
+
+    size_t helpers = std::min(workers.size(), count - 1);
+    {
+        std::lock_guard<std::mutex> lock(jobMutex);
+        for (size_t i = 0; i < helpers; i++) {
+            jobs.push_front([state] { runParallelFor(*state); });
+        }
+    }
+    if (helpers == 1) {
+        jobReady.notify_one();
+    } else {
+        jobReady.notify_all();
+    }
+
+    runParallelFor(*state);
+    std::unique_lock<std::mutex> lock(state->mutex);
+    state->finished.wait(lock, [&state] { return state->done.load() == state->count; });
+}
+
+unsigned jobWorkerCount() {
+    return static_cast<unsigned>(workers.size());
+}
+
+void postUpload(Upload upload) {
+    UploadNode* node = new UploadNode{std::move(upload), nullptr};
+    node->next = postedUploads.load(std::memory_order_relaxed);
+    while (!postedUploads.compare_exchange_weak(node->next, node,
+                                                std::memory_order_release,
+                                                std::memory_order_relaxed)) {
+    }
+}
+
+size_t processUploads(size_t byteBudget) {
+    // Take everything posted since the last call and restore posting order
+    UploadNode* node = postedUploads.exchange(nullptr, std::memory_order_acquire);
+    std::vector<UploadNode*> posted;
+    for (; node; node = node->next) {
+        posted.push_back(node);
+    }
+    for (auto it = posted.rbegin(); it != posted.rend(); ++it) {
+        pendingUploads.push_back(std::move((*it)->upload));
+        delete *it;
+    }
+
+    size_t uploaded = 0;
+    while (!pendingUploads.empty() && (uploaded == 0 || uploaded < byteBudget)) {
+        Upload upload = std::move(pendingUploads.front());
+        pendingUploads.pop_front();
+        uploaded += upload();
+    }
+    return uploaded;
+}
@@ -0,0 +1,73 @@
+#ifndef JOB_SYSTEM_H
+#define JOB_SYSTEM_H
+
+#include <cstddef>
+#include <functional>
+
+/**
+ * @file jobSystem.h
+ * @brief Worker pool for asset loading and the main-thread GL upload queue
+ *
+ * File reads, parsing and image decoding run as jobs on worker threads,
+ * which also help with per-frame work split by parallelFor.
+ * Since OpenGL calls must stay on the GLUT thread, a job finishes by posting
+ * an upload to a lock-free queue which the GLUT thread drains every frame
+ * with processUploads.
+ */
+
+// Work done on a worker thread
+typedef std::function<void()> Job;
+
+// Work done on the GLUT thread; returns the number of bytes sent to the GPU
+typedef std::function<size_t()> Upload;
+
+/**
+ * @brief Starts the worker threads (does nothing if they are already running)
+ *
+ * @param workerCount Number of threads, 0 = one less than the hardware threads
+ */
+void startJobWorkers(unsigned workerCount = 0);
+
+/**
+ * @brief Stops the workers after their current job
+ *
+ * Jobs that have not started are dropped. Also registered with atexit so
+ * the threads are joined before static destructors run.
+ */
+void stopJobWorkers();
+
+// Queues a job for the worker pool (runs inline if the pool is not started)
+void submitJob(Job job);
+
+/**
+ * @brief Runs task(0) .. task(count - 1) on the calling thread and the workers
+ *
+ * For per-frame work: the helper jobs go to the front of the queue, and
+ * the calling thread takes indices itself, so the call never waits behind
+ * an asset load; idle workers just make it finish sooner. Returns when
+ * every index is done.
+ *
+ * @param count Number of indices
+ * @param task Work for one index; must be safe to run concurrently for different indices
+ */
+void parallelFor(size_t count, const std::function<void(size_t)>& task);
+
+// Number of worker threads running (0 before startJobWorkers)
+unsigned jobWorkerCount();
+
+// Queues an upload for the GLUT thread; safe to call from any thread
+void postUpload(Upload upload);
+
+/**
+ * @brief Runs queued uploads on the GLUT thread
+ *
+ * Uploads run in the order they were posted until the byte budget is spent.
+ * At least one upload runs per call, so an upload larger than the budget
+ * still makes progress.
+ *
+ * @param byteBudget Bytes that may be sent to the GPU in this call
+ * @return Bytes actually uploaded
+ */
+size_t processUploads(size_t byteBudget);
+
+#endif // JOB_SYSTEM_H
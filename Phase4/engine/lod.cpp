@@ -0,0 +1,41 @@
+/**
+ * @file lod.cpp
+ * @brief Choosing a mesh's level of detail from its size on screen
+ */
+
+#include "lod.h"
+#include "matrix.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+float projectedRadius(const float* modelView, const Mesh& mesh, float pixelScale, float zNear) {
+    if (mesh.boundsRadius < 0) return FLT_MAX;
+
+    float eyeCenter[3];
+    mat4TransformPoint(modelView, mesh.boundsCenter, eyeCenter);
+    float radius = mesh.boundsRadius * mat4MaxScale(modelView);
+    float distance = -eyeCenter[2];
+    if (distance <= radius) return FLT_MAX;
+    return radius * pixelScale / std::max(distance, zNear);
+}
+
+unsigned selectMeshLevel(const Mesh& mesh, unsigned current, float radiusPixels) {
+    unsigned levels = meshLevelCount(mesh);
+    if (levels == 1 || radiusPixels == FLT_MAX) return 0;
+    current = std::min(current, levels - 1);
+
+    // Triangles needed for the projected area of the bounding sphere
+    float needed = static_cast<float>(M_PI) * radiusPixels * radiusPixels / LOD_PIXELS_PER_TRIANGLE;
+
+    // Finer as soon as the current level is too coarse...
+    while (current > 0 && meshTriangleCount(meshLevel(mesh, current)) < needed) {
+        current--;
+    }
+    // ...but coarser only with a margin
+    while (current + 1 < levels &&
+           meshTriangleCount(meshLevel(mesh, current + 1)) >= needed * (1.0f + LOD_HYSTERESIS)) {
+        current++;
+    }
+    return current;
+}
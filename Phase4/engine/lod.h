@@ -0,0 +1,65 @@
+#ifndef LOD_H
+#define LOD_H
+
+#include "engine.h"
+#include <algorithm>
+
+/**
+ * @file lod.h
+ * @brief Choosing a mesh's level of detail from its size on screen
+ *
+ * Meshes written with `generator --lod N` carry coarser levels in
+ * Mesh::lods, each with about a quarter of the triangles of the one
+ * before. Every frame each visible model picks the coarsest level that
+ * still gives its projected area LOD_PIXELS_PER_TRIANGLE pixels or fewer
+ * per triangle, so triangle counts follow the pixels a model covers.
+ *
+ * A model only moves to a coarser level once that level would do with
+ * LOD_HYSTERESIS more area to spare, so a model hovering at a threshold
+ * does not pop back and forth between two levels.
+ */
+
+// Screen area (in pixels) each triangle may cover before a finer level is used
+const float LOD_PIXELS_PER_TRIANGLE = 8.0f;
+
+// Extra margin a coarser level needs before a model switches to it (0.25 = 25%)
+const float LOD_HYSTERESIS = 0.25f;
+
+// Number of levels of detail of a mesh (1 without a LOD chain)
+inline unsigned meshLevelCount(const Mesh& mesh) {
+    return 1 + static_cast<unsigned>(mesh.lods.size());
+}
+
+// A level of detail of a mesh (0 is the mesh itself), clamped to the coarsest level
+inline const Mesh& meshLevel(const Mesh& mesh, unsigned level) {
+    if (level == 0 || mesh.lods.empty()) return mesh;
+    return *mesh.lods[std::min<size_t>(level, mesh.lods.size()) - 1];
+}
+
+// Number of triangles a mesh draws
+inline size_t meshTriangleCount(const Mesh& mesh) {
+    return (mesh.indexCount > 0 ? mesh.indexCount : mesh.vertexCount) / 3;
+}
+
+/**
+ * @brief Radius of a mesh's bounding sphere on screen, in pixels
+ *
+ * @param modelView Model-view matrix of the model
+ * @param mesh The model's mesh (with bounds)
+ * @param pixelScale Projection's y scale times half the viewport height
+ * @param zNear Near plane distance (spheres closer than this count as at the near plane)
+ * @return Projected radius, or a huge value if the camera is inside the sphere
+ */
+float projectedRadius(const float* modelView, const Mesh& mesh, float pixelScale, float zNear);
+
+/**
+ * @brief Picks the level of detail of a model for this frame
+ *
+ * @param mesh The model's mesh (level 0)
+ * @param current Level used in the last frame
+ * @param radiusPixels Projected radius of the mesh (see projectedRadius)
+ * @return Level to draw, at most meshLevelCount(mesh) - 1
+ */
+unsigned selectMeshLevel(const Mesh& mesh, unsigned current, float radiusPixels);
+
+#endif // LOD_H
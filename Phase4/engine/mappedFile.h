@@ -0,0 +1,45 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+#include <string>
+
+/**
+ * @brief Read-only memory mapping of a whole file
+ *
+ * The mapping is released when the object is destroyed or close() is called.
+ * Copying is disabled since the object owns the mapping.
+ */
+class MappedFile {
+public:
+    MappedFile();
+    ~MappedFile();
+
+    /**
+     * @brief Maps a file into memory
+     *
+     * @param filename Path of the file to map
+     * @return true on success; data() and size() are valid until close()
+     */
+    bool open(const std::string& filename);
+
+    // Unmaps the file (safe to call when nothing is mapped)
+    void close();
+
+    const char* data() const { return data_; }
+    size_t size() const { return size_; }
+    bool isOpen() const { return data_ != nullptr; }
+
+private:
+    MappedFile(const MappedFile&);
+    MappedFile& operator=(const MappedFile&);
+
+    const char* data_;
+    size_t size_;
+#ifdef _WIN32
+    void* fileHandle_;
+    void* mappingHandle_;
+#endif
+};
+
+#endif // MAPPED_FILE_H
@@ -0,0 +1,116 @@
+/**
+ * @file matrix.cpp
+ * @brief 4x4 matrix helpers (column-major)
+ */
+
+#include "matrix.h"
+#include "catmullrom.h"
+#include <cmath>
+#include <cstring>
+
+void mat4Identity(float* m) {
+    static const float identity[16] = {
+        1.0f, 0.0f, 0.0f, 0.0f,
+        0.0f, 1.0f, 0.0f, 0.0f,
+        0.0f, 0.0f, 1.0f, 0.0f,
+        0.0f, 0.0f, 0.0f, 1.0f
+    };
+    std::memcpy(m, identity, sizeof(identity));
+}
+
+void mat4Copy(const float* src, float* m) {
+    std::memcpy(m, src, 16 * sizeof(float));
+}
+
+void mat4Multiply(const float* a, const float* b, float* out) {
+    for (int col = 0; col < 4; col++) {
+        for (int row = 0; row < 4; row++) {
+            out[col * 4 + row] = a[row] * b[col * 4] +
+                                 a[4 + row] * b[col * 4 + 1] +
+                                 a[8 + row] * b[col * 4 + 2] +
+                                 a[12 + row] * b[col * 4 + 3];
+        }
+    }
+}
+
+void mat4PostMultiply(float* m, const float* b) {
+    float result[16];
+    mat4Multiply(m, b, result);
+    mat4Copy(result, m);
+}
+
+void mat4Translate(float* m, float x, float y, float z) {
+    // Only the last column changes
+    for (int row = 0; row < 4; row++) {
+        m[12 + row] += m[row] * x + m[4 + row] * y + m[8 + row] * z;
+    }
+}
+
+void mat4Rotate(float* m, float angle, float x, float y, float z) {
+    float len = std::sqrt(x * x + y * y + z * z);
+    if (len == 0.0f) return;
+    x /= len; y /= len; z /= len;
+
+    // Same matrix glRotatef builds
+    float radians = angle * static_cast<float>(M_PI) / 180.0f;
+    float c = std::cos(radians);
+    float s = std::sin(radians);
+    float t = 1.0f - c;
+    float r[16] = {
+        x * x * t + c,     y * x * t + z * s, z * x * t - y * s, 0.0f,
+        x * y * t - z * s, y * y * t + c,     z * y * t + x * s, 0.0f,
+        x * z * t + y * s, y * z * t - x * s, z * z * t + c,     0.0f,
+        0.0f,              0.0f,              0.0f,              1.0f
+    };
+    mat4PostMultiply(m, r);
+}
+
+void mat4Scale(float* m, float x, float y, float z) {
+    for (int row = 0; row < 4; row++) {
+        m[row] *= x;
+        m[4 + row] *= y;
+        m[8 + row] *= z;
+    }
+}
+
+void mat4TransformPoint(const float* m, const float* p, float* out) {
+    for (int row = 0; row < 3; row++) {
+        out[row] = m[row] * p[0] + m[4 + row] * p[1] + m[8 + row] * p[2] + m[12 + row];
+    }
+}
+
+float mat4MaxScale(const float* m) {
+    float maxSquared = 0.0f;
+    for (int col = 0; col < 3; col++) {
+        const float* axis = m + col * 4;
+        float squared = axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2];
+        if (squared > maxSquared) maxSquared = squared;
+    }
+    return std::sqrt(maxSquared);
+}
+
+void mat4LookAt(float* m, const float* eye, const float* center, const float* up) {
+    float forward[3] = {center[0] - eye[0], center[1] - eye[1], center[2] - eye[2]};
+    normalize(forward);
+    float side[3];
+    cross(forward, up, side);
+    normalize(side);
+    float realUp[3];
+    cross(side, forward, realUp);
+
+    mat4Identity(m);
+    m[0] = side[0];  m[4] = side[1];  m[8] = side[2];
+    m[1] = realUp[0]; m[5] = realUp[1]; m[9] = realUp[2];
+    m[2] = -forward[0]; m[6] = -forward[1]; m[10] = -forward[2];
+    mat4Translate(m, -eye[0], -eye[1], -eye[2]);
+}
+
+void mat4Perspective(float* m, float fovy, float aspect, float zNear, float zFar) {
+    float f = 1.0f / std::tan(fovy * static_cast<float>(M_PI) / 360.0f);
+    std::memset(m, 0, 16 * sizeof(float));
+    m[0] = f / aspect;
+    m[5] = f;
+    m[10] = (zFar + zNear) / (zNear - zFar);
+    m[11] = -1.0f;
+    m[14] = 2.0f * zFar * zNear / (zNear - zFar);
+}
@@ -0,0 +1,46 @@
+#ifndef MATRIX_H
+#define MATRIX_H
+
+/**
+ * @file matrix.h
+ * @brief 4x4 matrix helpers for the cached scene graph transforms
+ *
+ * Matrices are float[16] in column-major order, the layout glLoadMatrixf
+ * and buildRotMatrix use. Functions that modify a matrix multiply on the
+ * right, like the matching glTranslatef/glRotatef/glScalef calls.
+ */
+
+// m = identity
+void mat4Identity(float* m);
+
+// m = src
+void mat4Copy(const float* src, float* m);
+
+// out = a * b (out must not alias a or b)
+void mat4Multiply(const float* a, const float* b, float* out);
+
+// m = m * b
+void mat4PostMultiply(float* m, const float* b);
+
+// m = m * translation(x, y, z)
+void mat4Translate(float* m, float x, float y, float z);
+
+// m = m * rotation of angle degrees around (x, y, z); a zero axis leaves m unchanged
+void mat4Rotate(float* m, float angle, float x, float y, float z);
+
+// m = m * scale(x, y, z)
+void mat4Scale(float* m, float x, float y, float z);
+
+// out = m * (p, 1), the point p placed by m (out must not alias p)
+void mat4TransformPoint(const float* m, const float* p, float* out);
+
+// Largest factor by which m scales a length (the longest of its first three columns)
+float mat4MaxScale(const float* m);
+
+// m = view matrix of a camera, same as gluLookAt on an identity matrix
+void mat4LookAt(float* m, const float* eye, const float* center, const float* up);
+
+// m = projection matrix, same as gluPerspective on an identity matrix (fovy in degrees)
+void mat4Perspective(float* m, float fovy, float aspect, float zNear, float zFar);
+
+#endif // MATRIX_H
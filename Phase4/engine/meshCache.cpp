@@ -0,0 +1,653 @@
+/**
+ * @file meshCache.cpp
+ * @brief Registry of loaded meshes shared between models
+ *
+ * Scenes like dynamic_solar_system.xml reference the same sphere file for
+ * every body; the cache makes sure each file is parsed and uploaded once.
+ *
+ * Files are read and parsed by a job on the worker pool; the GL upload is
+ * posted back to the GLUT thread, which runs it from processUploads.
+ */
+
+#include "meshCache.h"
+#include "glStateCache.h"
+#include "jobSystem.h"
+#include "mappedFile.h"
+#include "meshFormat.h"
+#include "pathUtils.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <unordered_map>
+
+namespace {
+
+// Loaded meshes by canonical path
+std::unordered_map<std::string, std::unique_ptr<Mesh> > meshes;
+
+// Number of meshes whose load job has not been uploaded yet
+size_t pendingMeshes = 0;
+
+// Source of Mesh::loadId
+unsigned nextLoadId = 0;
+
+// CPU-side result of loading one level of detail
+struct LoadedLevel {
+    size_t offset = 0;        // Byte offset of the level in the file (direct uploads)
+    MeshFileHeader header;
+    std::vector<Point> vertices;
+    std::vector<Point> normals;
+    std::vector<float> texCoords;
+    std::vector<uint32_t> indices;
+    std::vector<float> interleaved;   // Vertex buffer contents built from the arrays above
+    float boundsMin[3] = {0.0f, 0.0f, 0.0f};
+    float boundsMax[3] = {0.0f, 0.0f, 0.0f};
+    float boundsRadius = -1.0f;       // Sphere around the box centre (-1 if no vertices)
+};
+
+// CPU-side result of a mesh load job
+struct LoadedMesh {
+    bool direct = false;      // bytes() hold a validated .3db to upload as is
+    MappedFile file;          // The file, in mapped mode
+    std::vector<char> fileData;   // The file, for quantized meshes read in streamed mode
+    std::vector<LoadedLevel> levels;  // Finest first; one unless the file holds a LOD chain
+
+    const char* bytes() const { return file.isOpen() ? file.data() : fileData.data(); }
+    size_t byteCount() const { return file.isOpen() ? file.size() : fileData.size(); }
+};
+
+// Whether vertex array objects are available (decided on the first upload)
+enum VertexArraySupport { VAO_UNKNOWN, VAO_SUPPORTED, VAO_UNSUPPORTED };
+VertexArraySupport vertexArraySupport = VAO_UNKNOWN;
+
+bool vertexArraysSupported() {
+    if (vertexArraySupport == VAO_UNKNOWN) {
+#ifdef __APPLE__
+        // Legacy Apple contexts only have the APPLE variant
+        vertexArraySupport = VAO_UNSUPPORTED;
+#else
+        vertexArraySupport = (GLEW_VERSION_3_0 || GLEW_ARB_vertex_array_object) ? VAO_SUPPORTED
+                                                                                : VAO_UNSUPPORTED;
+#endif
+    }
+    return vertexArraySupport == VAO_SUPPORTED;
+}
+
+/**
+ * @brief Points the fixed-function vertex arrays at a mesh's buffers
+ * 
+ * Recorded once into the mesh's vertex array object, or run before every
+ * draw when vertex array objects are not available.
+ * 
+ * @param mesh Uploaded mesh
+ */
+void setupMeshArrays(const Mesh& mesh) {
+    cachedBindBuffer(GL_ARRAY_BUFFER, mesh.vbo);
+    cachedClientState(GL_VERTEX_ARRAY, true);
+    glVertexPointer(3, mesh.positionType, mesh.vertexStride, 0);
+
+    if (mesh.normalOffset >= 0) {
+        cachedClientState(GL_NORMAL_ARRAY, true);
+        glNormalPointer(mesh.normalType, mesh.vertexStride, reinterpret_cast<const void*>(mesh.normalOffset));
+    } else {
+        cachedClientState(GL_NORMAL_ARRAY, false);
+    }
+
+    if (mesh.texCoordOffset >= 0) {
+        cachedClientState(GL_TEXTURE_COORD_ARRAY, true);
+        glTexCoordPointer(2, mesh.texCoordType, mesh.vertexStride, reinterpret_cast<const void*>(mesh.texCoordOffset));
+    } else {
+        cachedClientState(GL_TEXTURE_COORD_ARRAY, false);
+    }
+
+    cachedBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.ibo);
+}
+
+/**
+ * @brief Checks whether the GPU decodes quantized vertices
+ * 
+ * Needs 10:10:10:2 normals (GL 3.3 / ARB_vertex_type_2_10_10_10_rev) and
+ * half-float texture coordinates (GL 3.0 / ARB_half_float_vertex);
+ * otherwise quantized files are decoded to floats on load.
+ */
+bool packedVerticesSupported() {
+#ifdef __APPLE__
+    return false;
+#else
+    return (GLEW_VERSION_3_3 || GLEW_ARB_vertex_type_2_10_10_10_rev) &&
+           (GLEW_VERSION_3_0 || GLEW_ARB_half_float_vertex);
+#endif
+}
+
+// Records the mesh's array setup into a vertex array object, if available
+void createVertexArray(Mesh& mesh) {
+    if (!vertexArraysSupported()) return;
+    if (mesh.vao == 0) glGenVertexArrays(1, &mesh.vao);
+    cachedBindVertexArray(mesh.vao);
+    setupMeshArrays(mesh);
+    cachedBindVertexArray(0);
+    cachedBindBuffer(GL_ARRAY_BUFFER, 0);
+    cachedBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+}
+
+/**
+ * @brief Interleaves parsed arrays into one vertex buffer on the worker
+ * 
+ * Each vertex holds its position, then its normal and texture coordinates
+ * when the file has them (32 bytes for a full .3d vertex).
+ * 
+ * @param loaded Parsed arrays; fills loaded.interleaved
+ */
+void interleaveMesh(LoadedLevel& loaded) {
+    size_t count = loaded.vertices.size();
+    bool hasNormals = loaded.normals.size() == count;
+    bool hasTexCoords = loaded.texCoords.size() == count * 2;
+    size_t floatsPerVertex = 3 + (hasNormals ? 3 : 0) + (hasTexCoords ? 2 : 0);
+
+    loaded.interleaved.resize(count * floatsPerVertex);
+    float* out = loaded.interleaved.data();
+    for (size_t i = 0; i < count; i++) {
+        const Point& p = loaded.vertices[i];
+        *out++ = p.x;
+        *out++ = p.y;
+        *out++ = p.z;
+        if (hasNormals) {
+            const Point& n = loaded.normals[i];
+            *out++ = n.x;
+            *out++ = n.y;
+            *out++ = n.z;
+        }
+        if (hasTexCoords) {
+            *out++ = loaded.texCoords[i * 2];
+            *out++ = loaded.texCoords[i * 2 + 1];
+        }
+    }
+}
+
+/**
+ * @brief Creates (if needed) and fills an array buffer
+ * 
+ * @param buffer Buffer handle, generated on first use
+ * @param data Source data
+ * @param bytes Size of the data in bytes
+ */
+void uploadArrayBuffer(GLuint& buffer, const void* data, size_t bytes) {
+    if (buffer == 0) glGenBuffers(1, &buffer);
+    cachedBindBuffer(GL_ARRAY_BUFFER, buffer);
+    glBufferData(GL_ARRAY_BUFFER, bytes, data, GL_STATIC_DRAW);
+}
+
+/**
+ * @brief Creates (if needed) and fills the index buffer of a mesh
+ * 
+ * @param mesh Mesh whose ibo is filled
+ * @param indices Source indices
+ * @param count Number of indices
+ * @return Bytes uploaded
+ */
+size_t uploadIndexBuffer(Mesh& mesh, const uint32_t* indices, size_t count) {
+    if (mesh.ibo == 0) glGenBuffers(1, &mesh.ibo);
+    cachedBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.ibo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, count * sizeof(uint32_t), indices, GL_STATIC_DRAW);
+    cachedBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    mesh.indexCount = static_cast<GLsizei>(count);
+    return count * sizeof(uint32_t);
+}
+
+/**
+ * @brief Computes the bounding box and sphere of a mesh on the worker
+ * 
+ * @param count Number of vertices
+ * @param positionAt Callable writing the position of vertex i to a float[3]
+ * @param loaded Receives the bounds
+ */
+template <typename PositionAt>
+void computeBounds(size_t count, PositionAt positionAt, LoadedLevel& loaded) {
+    if (count == 0) return;
+    float p[3];
+    positionAt(0, p);
+    for (int k = 0; k < 3; k++) loaded.boundsMin[k] = loaded.boundsMax[k] = p[k];
+    for (size_t i = 1; i < count; i++) {
+        positionAt(i, p);
+        for (int k = 0; k < 3; k++) {
+            loaded.boundsMin[k] = std::min(loaded.boundsMin[k], p[k]);
+            loaded.boundsMax[k] = std::max(loaded.boundsMax[k], p[k]);
+        }
+    }
+
+    float center[3];
+    for (int k = 0; k < 3; k++) center[k] = (loaded.boundsMin[k] + loaded.boundsMax[k]) * 0.5f;
+    float radiusSquared = 0;
+    for (size_t i = 0; i < count; i++) {
+        positionAt(i, p);
+        float dx = p[0] - center[0], dy = p[1] - center[1], dz = p[2] - center[2];
+        radiusSquared = std::max(radiusSquared, dx * dx + dy * dy + dz * dz);
+    }
+    loaded.boundsRadius = std::sqrt(radiusSquared);
+}
+
+// Bounds of a validated .3db level, read from its vertex block
+void computeDirectBounds(const char* data, LoadedLevel& level) {
+    const MeshFileHeader& header = level.header;
+    const char* vertexData = data + level.offset + sizeof(MeshFileHeader);
+    if (header.attribMask & MESH_ATTRIB_QUANTIZED) {
+        MeshPositionQuantization q = meshPositionQuantization(header);
+        const unsigned char* packed = reinterpret_cast<const unsigned char*>(vertexData);
+        computeBounds(header.vertexCount, [&](size_t i, float* p) {
+            float normal[3], texCoord[2];
+            unpackQuantizedVertex(q, packed + i * MESH_QUANTIZED_VERTEX_SIZE, p, normal, texCoord);
+        }, level);
+    } else {
+        computeBounds(header.vertexCount, [vertexData](size_t i, float* p) {
+            std::memcpy(p, vertexData + i * 3 * sizeof(float), 3 * sizeof(float));
+        }, level);
+    }
+}
+
+/**
+ * @brief Opens a binary mesh that may be uploaded without parsing
+ * 
+ * In mapped mode every .3db file is mapped; in streamed mode only quantized
+ * files are read whole (when the GPU can decode them), since their vertex
+ * block is uploaded as is anyway.
+ * 
+ * @param filename Path of the model file
+ * @param mode How the file is read
+ * @param packedSupported Whether the GPU reads quantized vertex formats
+ * @param loaded Receives the file contents
+ * @return True if the file is a .3db and its bytes were loaded
+ */
+bool openDirectMesh(const std::string& filename, ModelLoadMode mode, bool packedSupported, LoadedMesh& loaded) {
+    if (mode == LOAD_MAPPED) {
+        return loaded.file.open(filename) && isMeshFileMagic(loaded.file.data(), loaded.file.size());
+    }
+    if (!packedSupported) return false;
+
+    std::ifstream file(filename, std::ios::binary);
+    MeshFileHeader header;
+    if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+        !isMeshFileMagic(&header, sizeof(header)) || !(header.attribMask & MESH_ATTRIB_QUANTIZED)) {
+        return false;
+    }
+    file.seekg(0);
+    loaded.fileData.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    return true;
+}
+
+/**
+ * @brief Validates one level of an opened .3db file for a direct upload
+ * 
+ * @param loaded The opened file
+ * @param offset Byte offset of the level
+ * @param filename Name used in error messages
+ * @param packedSupported Whether the GPU reads quantized vertex formats
+ * @param level Receives the header and bounds
+ * @return True if the level can be uploaded straight from the file bytes
+ */
+bool readDirectLevel(const LoadedMesh& loaded, size_t offset, const std::string& filename,
+                     bool packedSupported, LoadedLevel& level) {
+    const char* data = loaded.bytes() + offset;
+    level.offset = offset;
+    if (!parseMeshHeader(data, loaded.byteCount() - offset, filename, level.header)) return false;
+    if (!meshIndicesInRange(reinterpret_cast<const uint32_t*>(data + meshIndexOffset(level.header)),
+                            level.header.indexCount, level.header.vertexCount)) {
+        std::cerr << "Index out of range in " << filename << std::endl;
+        return false;
+    }
+    if ((level.header.attribMask & MESH_ATTRIB_QUANTIZED) && !packedSupported) {
+        return false;  // Decoded to floats by the parsing path
+    }
+    computeDirectBounds(loaded.bytes(), level);
+    return true;
+}
+
+/**
+ * @brief Reads a model file on a worker thread
+ * 
+ * Binary meshes opened by openDirectMesh are only validated, so the upload
+ * can read straight from the file bytes; everything else (text files,
+ * big-endian hosts, quantized files the GPU cannot decode, meshes that keep
+ * a CPU copy) is parsed into arrays and interleaved. Every level of a LOD
+ * chain is read; a level that fails to load ends the chain there.
+ * 
+ * @param filename Path of the model file
+ * @param mode How the file is read
+ * @param packedSupported Whether the GPU reads quantized vertex formats
+ * @param keepArrays Whether the mesh keeps its CPU arrays (MESH_KEEP_CPU_COPY)
+ * @param loaded Receives the file contents
+ */
+void readMesh(const std::string& filename, ModelLoadMode mode, bool packedSupported, bool keepArrays,
+              LoadedMesh& loaded) {
+    if (!keepArrays && isLittleEndianHost() && openDirectMesh(filename, mode, packedSupported, loaded)) {
+        size_t offset = 0;
+        while (loaded.levels.size() < MESH_MAX_LOD_LEVELS) {
+            LoadedLevel level;
+            if (!readDirectLevel(loaded, offset, filename, packedSupported, level)) break;
+            loaded.levels.push_back(std::move(level));
+            offset = meshNextLevelOffset(loaded.bytes(), loaded.byteCount(), offset, loaded.levels.back().header);
+            if (offset == 0) break;
+        }
+        loaded.direct = !loaded.levels.empty();
+        if (loaded.direct) {
+            if (loaded.levels[0].header.vertexCount == 0) {
+                std::cerr << "Warning: Model " << filename << " has no vertices!" << std::endl;
+            }
+            return;
+        }
+    }
+    loaded.file.close();
+    std::vector<char>().swap(loaded.fileData);
+
+    // Text files have no level offsets and are read as one level
+    std::vector<size_t> offsets = readMeshLevelOffsets(filename);
+    loaded.levels.resize(std::max<size_t>(offsets.size(), 1));
+    for (size_t l = 0; l < loaded.levels.size(); l++) {
+        LoadedLevel& level = loaded.levels[l];
+        if (l == 0) {
+            if (readModelFile(filename, level.vertices, level.normals, level.texCoords, &level.indices) &&
+                level.vertices.empty()) {
+                std::cerr << "Warning: Model " << filename << " has no vertices!" << std::endl;
+            }
+        } else if (!readBinaryModel(filename, level.vertices, level.normals, level.texCoords, &level.indices,
+                                    offsets[l]) || level.vertices.empty()) {
+            loaded.levels.resize(l);
+            break;
+        }
+        const std::vector<Point>& vertices = level.vertices;
+        computeBounds(vertices.size(), [&vertices](size_t i, float* p) {
+            p[0] = vertices[i].x;
+            p[1] = vertices[i].y;
+            p[2] = vertices[i].z;
+        }, level);
+        interleaveMesh(level);
+    }
+}
+
+/**
+ * @brief Uploads a binary mesh straight from the file bytes
+ * 
+ * The vertex data of a .3db file is contiguous, so it goes to glBufferData
+ * as one buffer straight from the file bytes (the mapped pages in mapped
+ * mode): quantized files are already interleaved, the others are laid out
+ * per attribute. The index block
+ * follows the same way. The mesh's CPU-side arrays stay empty.
+ * 
+ * @param mesh Mesh to upload into
+ * @param loaded Validated .3db file
+ * @param level Level of the file to upload
+ * @return Bytes uploaded
+ */
+size_t uploadDirectMesh(Mesh& mesh, const LoadedMesh& loaded, const LoadedLevel& level) {
+    const MeshFileHeader& header = level.header;
+    const char* data = loaded.bytes() + level.offset;
+    size_t count = header.vertexCount;
+    if (count == 0) return 0;
+
+    size_t bytes = meshIndexOffset(header) - sizeof(MeshFileHeader);
+    uploadArrayBuffer(mesh.vbo, data + sizeof(MeshFileHeader), bytes);
+    cachedBindBuffer(GL_ARRAY_BUFFER, 0);
+    if (header.attribMask & MESH_ATTRIB_QUANTIZED) {
+        // 16-byte vertices decoded by the GPU (layout in meshFormat.h)
+        MeshPositionQuantization q = meshPositionQuantization(header);
+        mesh.vertexStride = MESH_QUANTIZED_VERTEX_SIZE;
+        mesh.normalOffset = 8;
+        mesh.texCoordOffset = 12;
+        mesh.positionType = GL_SHORT;
+        mesh.normalType = GL_INT_2_10_10_10_REV;
+        mesh.texCoordType = GL_HALF_FLOAT;
+        mesh.quantized = true;
+        mesh.positionScale = q.scale;
+        for (int k = 0; k < 3; k++) mesh.positionOffset[k] = q.center[k];
+    } else {
+        mesh.vertexStride = 0;
+        mesh.normalOffset = -1;
+        mesh.texCoordOffset = -1;
+        if (header.attribMask & MESH_ATTRIB_NORMAL) {
+            mesh.normalOffset = meshAttribOffset(header, MESH_ATTRIB_NORMAL) - sizeof(MeshFileHeader);
+        }
+        if (header.attribMask & MESH_ATTRIB_TEXCOORD) {
+            mesh.texCoordOffset = meshAttribOffset(header, MESH_ATTRIB_TEXCOORD) - sizeof(MeshFileHeader);
+        }
+    }
+    if (header.indexCount > 0) {
+        bytes += uploadIndexBuffer(mesh, reinterpret_cast<const uint32_t*>(data + meshIndexOffset(header)),
+                                   header.indexCount);
+    }
+
+    mesh.vertexCount = static_cast<GLsizei>(count);
+    createVertexArray(mesh);
+    return bytes;
+}
+
+/**
+ * @brief Moves parsed arrays into the mesh and uploads them
+ * 
+ * The vertex buffer is the interleaved copy built by the load job, uploaded
+ * with a single glBufferData. Afterwards the arrays are freed unless the
+ * mesh keeps a CPU copy.
+ * 
+ * @param mesh Mesh to populate
+ * @param loaded Arrays read by the load job
+ * @return Bytes uploaded
+ */
+size_t uploadStreamedMesh(Mesh& mesh, LoadedLevel& loaded) {
+    mesh.vertices.swap(loaded.vertices);
+    mesh.normals.swap(loaded.normals);
+    mesh.texCoords.swap(loaded.texCoords);
+    mesh.indices.swap(loaded.indices);
+    if (mesh.vertices.empty()) return 0;
+
+    // Attribute offsets within one interleaved vertex
+    size_t count = mesh.vertices.size();
+    GLintptr offset = 3 * sizeof(float);
+    mesh.normalOffset = -1;
+    mesh.texCoordOffset = -1;
+    if (mesh.normals.size() == count) {
+        mesh.normalOffset = offset;
+        offset += 3 * sizeof(float);
+    }
+    if (mesh.texCoords.size() == count * 2) {
+        mesh.texCoordOffset = offset;
+        offset += 2 * sizeof(float);
+    }
+    mesh.vertexStride = static_cast<GLsizei>(offset);
+    mesh.positionType = mesh.normalType = mesh.texCoordType = GL_FLOAT;
+    mesh.quantized = false;
+    mesh.positionScale = 1.0f;
+    for (int k = 0; k < 3; k++) mesh.positionOffset[k] = 0.0f;
+
+    // Create and populate the vertex buffer
+    size_t bytes = loaded.interleaved.size() * sizeof(float);
+    uploadArrayBuffer(mesh.vbo, loaded.interleaved.data(), bytes);
+    cachedBindBuffer(GL_ARRAY_BUFFER, 0);
+    std::vector<float>().swap(loaded.interleaved);
+
+    // Create and populate index buffer if the mesh is indexed
+    if (!mesh.indices.empty()) {
+        bytes += uploadIndexBuffer(mesh, mesh.indices.data(), mesh.indices.size());
+    }
+
+    mesh.vertexCount = static_cast<GLsizei>(count);
+    createVertexArray(mesh);
+
+    // The GPU has its own copy; only meshes that opted in keep the arrays
+    if (!mesh.keepCpuCopy) {
+        std::vector<Point>().swap(mesh.vertices);
+        std::vector<Point>().swap(mesh.normals);
+        std::vector<float>().swap(mesh.texCoords);
+        std::vector<uint32_t>().swap(mesh.indices);
+    }
+    return bytes;
+}
+
+// Deletes the GL objects of a mesh and of its coarser levels
+void deleteMeshObjects(Mesh& mesh) {
+    if (mesh.vao) {
+        glDeleteVertexArrays(1, &mesh.vao);
+        forgetCachedVertexArray(mesh.vao);
+    }
+    if (mesh.vbo) {
+        glDeleteBuffers(1, &mesh.vbo);
+        forgetCachedBuffer(mesh.vbo);
+    }
+    if (mesh.ibo) {
+        glDeleteBuffers(1, &mesh.ibo);
+        forgetCachedBuffer(mesh.ibo);
+    }
+    mesh.vao = mesh.vbo = mesh.ibo = 0;
+    for (std::unique_ptr<Mesh>& lod : mesh.lods) deleteMeshObjects(*lod);
+}
+
+/**
+ * @brief Uploads one level of detail and copies its bounds
+ * 
+ * @param mesh Mesh of the level
+ * @param loaded Data read by the job
+ * @param level The level
+ * @return Bytes uploaded
+ */
+size_t finishLevel(Mesh& mesh, LoadedMesh& loaded, LoadedLevel& level) {
+    size_t bytes = loaded.direct ? uploadDirectMesh(mesh, loaded, level) : uploadStreamedMesh(mesh, level);
+    for (int k = 0; k < 3; k++) {
+        mesh.boundsMin[k] = level.boundsMin[k];
+        mesh.boundsMax[k] = level.boundsMax[k];
+        mesh.boundsCenter[k] = (level.boundsMin[k] + level.boundsMax[k]) * 0.5f;
+    }
+    mesh.boundsRadius = level.boundsRadius;
+    mesh.pending = false;
+    return bytes;
+}
+
+/**
+ * @brief Finishes a load job on the GLUT thread
+ * 
+ * The mesh may have been released (or released and acquired again) while
+ * the job ran; the upload is dropped unless the job still owns the mesh.
+ * Coarser levels of detail become meshes of their own in Mesh::lods, which
+ * keep their buffers across reloads.
+ * 
+ * @param key Cache key of the mesh
+ * @param loadId Load job that produced the data
+ * @param loaded Data read by the job
+ * @return Bytes uploaded
+ */
+size_t finishMesh(const std::string& key, unsigned loadId, LoadedMesh& loaded) {
+    auto it = meshes.find(key);
+    if (it == meshes.end() || it->second->loadId != loadId) return 0;
+
+    Mesh& mesh = *it->second;
+    size_t coarserLevels = loaded.levels.empty() ? 0 : loaded.levels.size() - 1;
+    while (mesh.lods.size() > coarserLevels) {
+        deleteMeshObjects(*mesh.lods.back());
+        mesh.lods.pop_back();
+    }
+    while (mesh.lods.size() < coarserLevels) {
+        mesh.lods.push_back(std::unique_ptr<Mesh>(new Mesh()));
+        mesh.lods.back()->path = mesh.path;
+    }
+
+    size_t bytes = 0;
+    for (size_t l = 0; l < loaded.levels.size(); l++) {
+        bytes += finishLevel(l == 0 ? mesh : *mesh.lods[l - 1], loaded, loaded.levels[l]);
+    }
+    mesh.pending = false;
+    pendingMeshes--;
+    return bytes;
+}
+
+/**
+ * @brief Submits the load job of a mesh
+ * 
+ * Any job already running for the mesh is superseded: its upload is
+ * dropped because the mesh gets a new loadId.
+ * 
+ * @param mesh Mesh to (re)load
+ * @param filename Path of the model file
+ * @param mode How the file is read
+ */
+void startMeshLoad(Mesh& mesh, const std::string& filename, ModelLoadMode mode) {
+    if (!mesh.pending) {
+        mesh.pending = true;
+        pendingMeshes++;
+    }
+    mesh.loadId = ++nextLoadId;
+
+    // Failed loads stay cached too, so a broken file is only reported once
+    std::string key = mesh.path;
+    unsigned loadId = mesh.loadId;
+    bool packedSupported = packedVerticesSupported();
+    bool keepArrays = mesh.keepCpuCopy;
+    submitJob([filename, key, mode, packedSupported, keepArrays, loadId]() {
+        std::shared_ptr<LoadedMesh> loaded(new LoadedMesh());
+        readMesh(filename, mode, packedSupported, keepArrays, *loaded);
+        postUpload([key, loadId, loaded]() { return finishMesh(key, loadId, *loaded); });
+    });
+}
+
+} // namespace
+
+Mesh* acquireMesh(const std::string& filename, ModelLoadMode mode, MeshResidency residency) {
+    std::string key = canonicalPath(filename);
+
+    auto it = meshes.find(key);
+    if (it != meshes.end()) {
+        Mesh& mesh = *it->second;
+        mesh.refCount++;
+        if (residency == MESH_KEEP_CPU_COPY && !mesh.keepCpuCopy) {
+            // The arrays were (or will be) freed: load the file again, keeping them
+            mesh.keepCpuCopy = true;
+            startMeshLoad(mesh, filename, mode);
+        }
+        return &mesh;
+    }
+
+    std::unique_ptr<Mesh> mesh(new Mesh());
+    mesh->path = key;
+    mesh->refCount = 1;
+    mesh->keepCpuCopy = residency == MESH_KEEP_CPU_COPY;
+    mesh->pending = false;
+    startMeshLoad(*mesh, filename, mode);
+
+    Mesh* result = mesh.get();
+    meshes[key] = std::move(mesh);
+    return result;
+}
+
+void releaseMesh(Mesh* mesh) {
+    if (!mesh) return;
+    if (--mesh->refCount > 0) return;
+
+    if (mesh->pending) pendingMeshes--;
+    deleteMeshObjects(*mesh);
+    meshes.erase(mesh->path);  // Destroys the mesh
+}
+
+void bindMeshArrays(const Mesh& mesh) {
+    if (mesh.vao != 0) {
+        cachedBindVertexArray(mesh.vao);
+    } else {
+        if (vertexArraysSupported()) cachedBindVertexArray(0);
+        setupMeshArrays(mesh);
+    }
+}
+
+void unbindMeshArrays() {
+    if (vertexArraysSupported()) cachedBindVertexArray(0);
+    cachedClientState(GL_VERTEX_ARRAY, false);
+    cachedClientState(GL_NORMAL_ARRAY, false);
+    cachedClientState(GL_TEXTURE_COORD_ARRAY, false);
+    cachedBindBuffer(GL_ARRAY_BUFFER, 0);
+    cachedBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+}
+
+size_t loadedMeshCount() {
+    return meshes.size();
+}
+
+size_t pendingMeshCount() {
+    return pendingMeshes;
+}
@@ -0,0 +1,68 @@
+#ifndef MESH_CACHE_H
+#define MESH_CACHE_H
+
+#include "engine.h"
+#include "modelLoader.h"
+#include <string>
+
+// What stays in memory after a mesh is uploaded
+enum MeshResidency {
+    MESH_GPU_ONLY,        // CPU arrays are freed; counts and attribute offsets remain
+    MESH_KEEP_CPU_COPY    // vertices/normals/texCoords/indices stay filled (picking, collision)
+};
+
+/**
+ * @brief Returns the shared mesh for a model file, loading it on first use
+ *
+ * Meshes are keyed by canonical path, so every Model that references the
+ * same file shares one set of CPU arrays and GL buffers. Each call adds a
+ * reference that must be dropped with releaseMesh.
+ *
+ * A new file is loaded asynchronously: the mesh comes back with pending set
+ * and vertexCount 0, and is filled in when processUploads runs its upload.
+ * Must be called from the GLUT thread.
+ *
+ * Meshes keep no CPU copy of their geometry unless some caller asks for
+ * MESH_KEEP_CPU_COPY. Asking for it on a mesh that is already loaded
+ * without one reloads the file (the mesh is pending again meanwhile, but
+ * keeps drawing with its current buffers).
+ *
+ * @param filename Path of the .3d/.3db file
+ * @param mode How the file is read and uploaded (a kept CPU copy is always parsed)
+ * @param residency Whether this caller needs the CPU arrays
+ * @return The shared mesh (never null; vertexCount stays 0 if loading failed)
+ */
+Mesh* acquireMesh(const std::string& filename, ModelLoadMode mode,
+                  MeshResidency residency = MESH_GPU_ONLY);
+
+/**
+ * @brief Drops a reference to a mesh returned by acquireMesh
+ *
+ * When the last reference goes away the GL buffers are deleted and the
+ * mesh is removed from the cache.
+ *
+ * @param mesh Mesh to release (null is ignored)
+ */
+void releaseMesh(Mesh* mesh);
+
+/**
+ * @brief Binds a mesh's vertex and index buffers for fixed-function drawing
+ *
+ * One glBindVertexArray when vertex array objects are available; otherwise
+ * the client-state pointers are set up from the mesh's single vertex buffer.
+ * The mesh must be uploaded (vertexCount > 0).
+ *
+ * @param mesh Mesh to draw next
+ */
+void bindMeshArrays(const Mesh& mesh);
+
+// Restores the default vertex array state after a run of bindMeshArrays draws
+void unbindMeshArrays();
+
+// Number of distinct meshes currently loaded
+size_t loadedMeshCount();
+
+// Number of meshes still waiting for their load job
+size_t pendingMeshCount();
+
+#endif // MESH_CACHE_H
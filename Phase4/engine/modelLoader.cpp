@@ -0,0 +1,452 @@
+/**
+ * @file modelLoader.cpp
+ * @brief Readers for the text (.3d) and binary (.3db) model formats
+ *
+ * These functions only fill CPU-side arrays; uploading to OpenGL buffers
+ * is done by loadModel in engine.cpp. The text reader works on the whole
+ * file mapped in memory: the column layout is detected once from the first
+ * data line and floats are parsed by hand into pre-sized arrays.
+ */
+
+#include "modelLoader.h"
+#include "mappedFile.h"
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+static_assert(sizeof(Point) == 3 * sizeof(float), "Point must be three tightly packed floats");
+
+bool readModelFile(const std::string& filename,
+                   std::vector<Point>& vertices,
+                   std::vector<Point>& normals,
+                   std::vector<float>& texCoords,
+                   std::vector<uint32_t>* indices) {
+    std::ifstream file(filename, std::ios::binary);
+    if (!file.is_open()) {
+        std::cerr << "Error opening file: " << filename << std::endl;
+        return false;
+    }
+
+    // Sniff the magic number to pick the reader
+    char magic[sizeof(MESH_FILE_MAGIC)] = {0};
+    file.read(magic, sizeof(magic));
+    bool binary = isMeshFileMagic(magic, static_cast<size_t>(file.gcount()));
+    file.close();
+
+    if (binary) {
+        return readBinaryModel(filename, vertices, normals, texCoords, indices);
+    }
+    if (indices) indices->clear();
+    return readTextModel(filename, vertices, normals, texCoords);
+}
+
+/**
+ * @brief Expands indexed vertex arrays into a triangle list
+ *
+ * @param indices Index list
+ * @param vertices Positions, replaced by one entry per index
+ * @param normals Normals (may be empty), expanded the same way
+ * @param texCoords Texture coordinates (may be empty), expanded the same way
+ */
+static void expandIndices(const std::vector<uint32_t>& indices,
+                          std::vector<Point>& vertices,
+                          std::vector<Point>& normals,
+                          std::vector<float>& texCoords) {
+    std::vector<Point> expandedVertices, expandedNormals;
+    std::vector<float> expandedTexCoords;
+    expandedVertices.reserve(indices.size());
+    for (uint32_t index : indices) {
+        expandedVertices.push_back(vertices[index]);
+        if (!normals.empty()) expandedNormals.push_back(normals[index]);
+        if (!texCoords.empty()) {
+            expandedTexCoords.push_back(texCoords[index * 2]);
+            expandedTexCoords.push_back(texCoords[index * 2 + 1]);
+        }
+    }
+    vertices.swap(expandedVertices);
+    normals.swap(expandedNormals);
+    texCoords.swap(expandedTexCoords);
+}
+
+bool parseMeshHeader(const char* data, size_t fileSize, const std::string& filename, MeshFileHeader& header) {
+    if (fileSize < sizeof(MeshFileHeader) || !isMeshFileMagic(data, fileSize)) {
+        std::cerr << "Not a binary mesh: " << filename << std::endl;
+        return false;
+    }
+    std::memcpy(&header, data, sizeof(header));
+    if (!isLittleEndianHost()) swapMeshHeader(header);
+
+    if (header.version < MESH_FILE_MIN_VERSION || header.version > MESH_FILE_VERSION) {
+        std::cerr << "Unsupported mesh version " << header.version << " in " << filename << std::endl;
+        return false;
+    }
+    if (!isValidMeshAttribMask(header.attribMask)) {
+        std::cerr << "Malformed mesh file: " << filename << std::endl;
+        return false;
+    }
+    if (fileSize < meshFileSize(header)) {
+        std::cerr << "Truncated mesh data in " << filename << std::endl;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Reads the float attribute blocks of an unquantized .3db file
+ *
+ * Each attribute block is read straight into its destination array.
+ *
+ * @param file Stream positioned after the header
+ * @param header Validated header
+ * @param swap Whether the words must be byte-swapped (big-endian host)
+ * @param vertices Output positions
+ * @param normals Output normals (left empty if the file has none)
+ * @param texCoords Output texture coordinates (left empty if the file has none)
+ */
+static void readFloatBlocks(std::istream& file, const MeshFileHeader& header, bool swap,
+                            std::vector<Point>& vertices,
+                            std::vector<Point>& normals,
+                            std::vector<float>& texCoords) {
+    size_t count = header.vertexCount;
+    vertices.resize(count);
+    file.read(reinterpret_cast<char*>(vertices.data()), count * sizeof(Point));
+    if (swap) swapWords(vertices.data(), count * 3);
+
+    normals.clear();
+    if (header.attribMask & MESH_ATTRIB_NORMAL) {
+        normals.resize(count);
+        file.read(reinterpret_cast<char*>(normals.data()), count * sizeof(Point));
+        if (swap) swapWords(normals.data(), count * 3);
+    }
+
+    texCoords.clear();
+    if (header.attribMask & MESH_ATTRIB_TEXCOORD) {
+        texCoords.resize(count * 2);
+        file.read(reinterpret_cast<char*>(texCoords.data()), count * 2 * sizeof(float));
+        if (swap) swapWords(texCoords.data(), count * 2);
+    }
+}
+
+bool readBinaryModel(const std::string& filename,
+                     std::vector<Point>& vertices,
+                     std::vector<Point>& normals,
+                     std::vector<float>& texCoords,
+                     std::vector<uint32_t>* indices,
+                     size_t offset) {
+    std::ifstream file(filename, std::ios::binary | std::ios::ate);
+    if (!file.is_open()) {
+        std::cerr << "Error opening file: " << filename << std::endl;
+        return false;
+    }
+    size_t fileSize = static_cast<size_t>(file.tellg());
+    file.seekg(offset);
+
+    MeshFileHeader header;
+    if (fileSize < offset + sizeof(header) || !file.read(reinterpret_cast<char*>(&header), sizeof(header))) {
+        std::cerr << "Truncated mesh header in " << filename << std::endl;
+        return false;
+    }
+    MeshFileHeader raw = header;
+    if (!parseMeshHeader(reinterpret_cast<const char*>(&raw), fileSize - offset, filename, header)) {
+        return false;
+    }
+    bool swap = !isLittleEndianHost();
+
+    size_t count = header.vertexCount;
+    if (header.attribMask & MESH_ATTRIB_QUANTIZED) {
+        // Quantized vertices are decoded back to floats
+        std::vector<unsigned char> packed(count * MESH_QUANTIZED_VERTEX_SIZE);
+        file.read(reinterpret_cast<char*>(packed.data()), packed.size());
+        MeshPositionQuantization q = meshPositionQuantization(header);
+        vertices.resize(count);
+        normals.resize(count);
+        texCoords.resize(count * 2);
+        for (size_t i = 0; i < count; i++) {
+            unpackQuantizedVertex(q, &packed[i * MESH_QUANTIZED_VERTEX_SIZE], &vertices[i].x,
+                                  &normals[i].x, &texCoords[i * 2]);
+        }
+    } else {
+        readFloatBlocks(file, header, swap, vertices, normals, texCoords);
+    }
+
+    std::vector<uint32_t> fileIndices;
+    fileIndices.resize(header.indexCount);
+    file.read(reinterpret_cast<char*>(fileIndices.data()), fileIndices.size() * sizeof(uint32_t));
+    if (swap) swapWords(fileIndices.data(), fileIndices.size());
+
+    if (!file) {
+        std::cerr << "Error reading mesh data from " << filename << std::endl;
+        return false;
+    }
+    if (!meshIndicesInRange(fileIndices.data(), fileIndices.size(), header.vertexCount)) {
+        std::cerr << "Index out of range in " << filename << std::endl;
+        return false;
+    }
+
+    // Callers that cannot draw indexed geometry get a plain triangle list
+    if (indices) {
+        indices->swap(fileIndices);
+    } else if (!fileIndices.empty()) {
+        expandIndices(fileIndices, vertices, normals, texCoords);
+    }
+    return true;
+}
+
+std::vector<size_t> readMeshLevelOffsets(const std::string& filename) {
+    std::vector<size_t> offsets;
+    std::ifstream file(filename, std::ios::binary | std::ios::ate);
+    if (!file.is_open()) return offsets;
+    size_t fileSize = static_cast<size_t>(file.tellg());
+
+    size_t offset = 0;
+    while (offsets.size() < MESH_MAX_LOD_LEVELS && fileSize - offset >= sizeof(MeshFileHeader)) {
+        char raw[sizeof(MeshFileHeader)];
+        file.seekg(offset);
+        if (!file.read(raw, sizeof(raw)) || !isMeshFileMagic(raw, sizeof(raw))) break;
+        MeshFileHeader header;
+        if (!parseMeshHeader(raw, fileSize - offset, filename, header)) break;
+        offsets.push_back(offset);
+        offset += meshFileSize(header);
+    }
+    return offsets;
+}
+
+namespace {
+
+// Exact powers of ten in double precision, used by the fast float path
+const double kPowersOfTen[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+inline bool isBlank(char c) {
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+inline bool isDigit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+// Skips spaces and tabs, stopping at the end of the line
+inline const char* skipBlanks(const char* p, const char* end) {
+    while (p < end && isBlank(*p)) ++p;
+    return p;
+}
+
+// Returns the end of the current line (the '\n' or the end of the buffer)
+inline const char* findLineEnd(const char* p, const char* end) {
+    const void* nl = std::memchr(p, '\n', static_cast<size_t>(end - p));
+    return nl ? static_cast<const char*>(nl) : end;
+}
+
+/**
+ * Slow path for tokens the fast parser does not handle (nan, inf, very long
+ * mantissas): copies the token to a stack buffer and uses strtof.
+ */
+const char* parseFloatSlow(const char* p, const char* end, float& out) {
+    char token[64];
+    size_t length = 0;
+    while (p + length < end && !isBlank(p[length]) && p[length] != '\n' && length < sizeof(token) - 1) {
+        token[length] = p[length];
+        ++length;
+    }
+    token[length] = '\0';
+
+    char* parsedEnd = nullptr;
+    out = std::strtof(token, &parsedEnd);
+    if (parsedEnd == token || static_cast<size_t>(parsedEnd - token) != length) return nullptr;
+    return p + length;
+}
+
+/**
+ * Parses one float starting at p (no leading blanks).
+ * Plain decimal and exponent notation are parsed without allocating or
+ * calling into the C library; anything else falls back to parseFloatSlow.
+ *
+ * @return Pointer just past the number, or nullptr if p does not start a number
+ */
+const char* parseFloat(const char* p, const char* end, float& out) {
+    const char* start = p;
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+')) {
+        negative = (*p == '-');
+        ++p;
+    }
+
+    // Accumulate up to 18 significant digits, tracking the decimal exponent
+    const uint64_t maxMantissa = 100000000000000000ULL;
+    uint64_t mantissa = 0;
+    int exponent = 0;
+    bool anyDigits = false;
+    while (p < end && isDigit(*p)) {
+        if (mantissa < maxMantissa) mantissa = mantissa * 10 + static_cast<uint64_t>(*p - '0');
+        else exponent++;
+        anyDigits = true;
+        ++p;
+    }
+    if (p < end && *p == '.') {
+        ++p;
+        while (p < end && isDigit(*p)) {
+            if (mantissa < maxMantissa) {
+                mantissa = mantissa * 10 + static_cast<uint64_t>(*p - '0');
+                exponent--;
+            }
+            anyDigits = true;
+            ++p;
+        }
+    }
+    if (!anyDigits) return parseFloatSlow(start, end, out);
+
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        const char* q = p + 1;
+        bool expNegative = false;
+        if (q < end && (*q == '-' || *q == '+')) {
+            expNegative = (*q == '-');
+            ++q;
+        }
+        if (q < end && isDigit(*q)) {
+            int value = 0;
+            while (q < end && isDigit(*q)) {
+                if (value < 10000) value = value * 10 + (*q - '0');
+                ++q;
+            }
+            exponent += expNegative ? -value : value;
+            p = q;
+        }
+    }
+
+    // The number must end at a separator; anything else (e.g. "1.5f") goes to strtof
+    if (p < end && !isBlank(*p) && *p != '\n') return parseFloatSlow(start, end, out);
+
+    double value = static_cast<double>(mantissa);
+    if (mantissa != 0) {
+        if (exponent >= -22 && exponent <= 22) {
+            value = exponent < 0 ? value / kPowersOfTen[-exponent] : value * kPowersOfTen[exponent];
+        } else {
+            value *= std::pow(10.0, exponent);
+        }
+    }
+    out = static_cast<float>(negative ? -value : value);
+    return p;
+}
+
+// Counts the numbers on a line, used to detect the file layout
+int countColumns(const char* p, const char* lineEnd) {
+    int columns = 0;
+    float ignored;
+    while (true) {
+        p = skipBlanks(p, lineEnd);
+        if (p >= lineEnd) break;
+        p = parseFloat(p, lineEnd, ignored);
+        if (!p) break;
+        columns++;
+    }
+    return columns;
+}
+
+// Returns true for lines with no data (blank or '#' comments)
+inline bool isSkippedLine(const char* p, const char* lineEnd) {
+    p = skipBlanks(p, lineEnd);
+    return p >= lineEnd || *p == '#';
+}
+
+} // namespace
+
+bool readTextModel(const std::string& filename,
+                   std::vector<Point>& vertices,
+                   std::vector<Point>& normals,
+                   std::vector<float>& texCoords) {
+    vertices.clear();
+    normals.clear();
+    texCoords.clear();
+
+    MappedFile file;
+    if (!file.open(filename)) {
+        // Mapping fails for empty files, which are valid (but empty) models
+        std::ifstream probe(filename);
+        if (!probe.is_open()) {
+            std::cerr << "Error opening file: " << filename << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    const char* begin = file.data();
+    const char* end = begin + file.size();
+
+    // Detect the layout once from the first data line:
+    // 8 columns = position + normal + uv, 5 = position + uv, 3 = position
+    int columns = 0;
+    for (const char* line = begin; line < end; ) {
+        const char* lineEnd = findLineEnd(line, end);
+        if (!isSkippedLine(line, lineEnd)) {
+            columns = countColumns(line, lineEnd);
+            break;
+        }
+        line = lineEnd + 1;
+    }
+    if (columns >= 8) columns = 8;
+    else if (columns >= 5) columns = 5;
+    else if (columns >= 3) columns = 3;
+    else return true;  // No data lines
+
+    bool hasNormals = (columns == 8);
+    bool hasTexCoords = (columns != 3);
+
+    // Every vertex is on its own line, so the line count bounds the vertex count
+    size_t maxVertices = 1;
+    for (const char* p = begin; (p = static_cast<const char*>(std::memchr(p, '\n', static_cast<size_t>(end - p)))); ++p) {
+        maxVertices++;
+    }
+    vertices.resize(maxVertices);
+    if (hasNormals) normals.resize(maxVertices);
+    if (hasTexCoords) texCoords.resize(maxVertices * 2);
+
+    size_t count = 0;
+    int lineNum = 0;
+    float values[8];
+    for (const char* line = begin; line < end; ) {
+        const char* lineEnd = findLineEnd(line, end);
+        ++lineNum;
+
+        if (!isSkippedLine(line, lineEnd)) {
+            const char* p = line;
+            int parsed = 0;
+            while (parsed < columns) {
+                p = skipBlanks(p, lineEnd);
+                if (p >= lineEnd) break;
+                p = parseFloat(p, lineEnd, values[parsed]);
+                if (!p) break;
+                parsed++;
+            }
+
+            if (parsed == columns) {
+                Point& vertex = vertices[count];
+                vertex.x = values[0];
+                vertex.y = values[1];
+                vertex.z = values[2];
+                if (hasNormals) {
+                    Point& normal = normals[count];
+                    normal.x = values[3];
+                    normal.y = values[4];
+                    normal.z = values[5];
+                }
+                if (hasTexCoords) {
+                    texCoords[count * 2] = values[columns - 2];
+                    texCoords[count * 2 + 1] = values[columns - 1];
+                }
+                count++;
+            } else {
+                std::cerr << "Malformed line " << lineNum << " in " << filename << std::endl;
+            }
+        }
+        line = lineEnd + 1;
+    }
+
+    vertices.resize(count);
+    if (hasNormals) normals.resize(count);
+    if (hasTexCoords) texCoords.resize(count * 2);
+    return true;
+}
@@ -0,0 +1,88 @@
+#ifndef MODEL_LOADER_H
+#define MODEL_LOADER_H
+
+#include "engine.h"
+#include "meshFormat.h"
+#include <string>
+#include <vector>
+
+// How loadModel gets model data from disk to the GPU
+enum ModelLoadMode {
+    LOAD_STREAM,  // Read into the Model's CPU arrays, then upload them
+    LOAD_MAPPED   // Memory-map binary meshes and upload straight from the mapping
+};
+
+/**
+ * @brief Reads a model file into CPU-side vertex arrays
+ *
+ * The format is detected from the file contents: files starting with the
+ * .3db magic number are read as binary meshes, anything else is parsed as
+ * the text .3d format (one vertex per line).
+ *
+ * @param filename Path of the model file
+ * @param vertices Output vertex positions
+ * @param normals Output normals (left empty if the file has none)
+ * @param texCoords Output texture coordinates, two floats per vertex (left empty if the file has none)
+ * @param indices Output index list (empty for triangle lists); if null,
+ *        indexed files are expanded into a triangle list
+ * @return true if the file was read successfully
+ */
+bool readModelFile(const std::string& filename,
+                   std::vector<Point>& vertices,
+                   std::vector<Point>& normals,
+                   std::vector<float>& texCoords,
+                   std::vector<uint32_t>* indices = nullptr);
+
+/**
+ * @brief Reads a binary .3db model file
+ *
+ * @param offset Byte offset of the mesh in the file (a level of a LOD
+ *        chain, see readMeshLevelOffsets); 0 for the first mesh
+ * @see readModelFile
+ */
+bool readBinaryModel(const std::string& filename,
+                     std::vector<Point>& vertices,
+                     std::vector<Point>& normals,
+                     std::vector<float>& texCoords,
+                     std::vector<uint32_t>* indices = nullptr,
+                     size_t offset = 0);
+
+/**
+ * @brief Finds the levels of detail stored in a binary mesh file
+ *
+ * Walks the chain of headers; a level that fails to validate ends it.
+ *
+ * @param filename Path of the model file
+ * @return Byte offset of each level, finest first (empty if the file is not a valid .3db)
+ */
+std::vector<size_t> readMeshLevelOffsets(const std::string& filename);
+
+/**
+ * @brief Validates the header of a binary mesh
+ *
+ * Checks the magic number, version, attribute mask and that the file is
+ * large enough for all attribute and index blocks the header announces.
+ *
+ * @param data Start of the file contents (at least sizeof(MeshFileHeader) bytes if fileSize allows)
+ * @param fileSize Total size of the file in bytes
+ * @param filename Name used in error messages
+ * @param header Output header converted to host byte order
+ * @return true if the file holds a complete, supported mesh
+ */
+bool parseMeshHeader(const char* data, size_t fileSize, const std::string& filename, MeshFileHeader& header);
+
+/**
+ * @brief Reads a text .3d model file
+ *
+ * Lines hold 3 (position), 5 (position + uv) or 8 (position + normal + uv)
+ * numbers; the layout is taken from the first data line and used for the
+ * whole file. Blank lines and lines starting with '#' are skipped.
+ *
+ * @see readModelFile
+ */
+bool readTextModel(const std::string& filename,
+                   std::vector<Point>& vertices,
+                   std::vector<Point>& normals,
+                   std::vector<float>& texCoords);
+
+#endif // MODEL_LOADER_H
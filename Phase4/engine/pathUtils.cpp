@@ -0,0 +1,28 @@
+/**
+ * @file pathUtils.cpp
+ * @brief File path helpers shared by the engine's resource caches
+ */
+
+#include "pathUtils.h"
+
+#ifdef _WIN32
+#include <cstdlib>
+#else
+#include <climits>
+#include <cstdlib>
+#endif
+
+std::string canonicalPath(const std::string& path) {
+#ifdef _WIN32
+    char resolved[_MAX_PATH];
+    if (_fullpath(resolved, path.c_str(), _MAX_PATH)) {
+        return std::string(resolved);
+    }
+#else
+    char resolved[PATH_MAX];
+    if (realpath(path.c_str(), resolved)) {
+        return std::string(resolved);
+    }
+#endif
+    return path;
+}
@@ -0,0 +1,18 @@
+#ifndef PATH_UTILS_H
+#define PATH_UTILS_H
+
+#include <string>
+
+/**
+ * @brief Resolves a file path to a canonical absolute form
+ *
+ * "../tests/a.3d" and "../engine/../tests/a.3d" map to the same string, so
+ * the result can be used as a cache key. If the file does not exist the
+ * path is returned unchanged.
+ *
+ * @param path Relative or absolute file path
+ * @return Canonical absolute path, or the input if it cannot be resolved
+ */
+std::string canonicalPath(const std::string& path);
+
+#endif // PATH_UTILS_H
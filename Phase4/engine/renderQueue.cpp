@@ -0,0 +1,166 @@
+/**
+ * @file renderQueue.cpp
+ * @brief Draws models one at a time, sorted to change GL state as rarely as possible
+ */
+
+#include "renderQueue.h"
+#include "glStateCache.h"
+#include "lod.h"
+#include "meshCache.h"
+#include "texture.h"
+#include <algorithm>
+
+namespace {
+
+/**
+ * @brief Sets the fixed-function material of the next draws
+ *
+ * Materials left at black diffuse and ambient (nothing set in the XML)
+ * draw as plain white.
+ *
+ * @param material The material
+ */
+void applyMaterial(const Material& material) {
+    // Only apply materials if they are defined in the XML
+    bool hasDefinedMaterial = (material.diffuse.r > 0 ||
+                               material.diffuse.g > 0 ||
+                               material.diffuse.b > 0 ||
+                               material.ambient.r > 0 ||
+                               material.ambient.g > 0 ||
+                               material.ambient.b > 0);
+    if (hasDefinedMaterial) {
+        float diffuse[4] = {material.diffuse.r, material.diffuse.g, material.diffuse.b, 1.0f};
+        float ambient[4] = {material.ambient.r, material.ambient.g, material.ambient.b, 1.0f};
+        float specular[4] = {material.specular.r, material.specular.g, material.specular.b, 1.0f};
+        float emissive[4] = {material.emissive.r, material.emissive.g, material.emissive.b, 0.5f};
+        cachedMaterial(GL_DIFFUSE, diffuse);
+        cachedMaterial(GL_AMBIENT, ambient);
+        cachedMaterial(GL_SPECULAR, specular);
+        cachedMaterial(GL_EMISSION, emissive);
+        cachedMaterial(GL_SHININESS, &material.shininess);
+    } else {
+        // Apply default material (white)
+        float defaultDiffuse[4] = {1.0f, 1.0f, 1.0f, 1.0f};
+        float defaultAmbient[4] = {0.2f, 0.2f, 0.2f, 1.0f};
+        float defaultSpecular[4] = {0.0f, 0.0f, 0.0f, 1.0f};
+        float defaultEmission[4] = {0.0f, 0.0f, 0.0f, 1.0f};
+        float defaultShininess = 0.0f;
+        cachedMaterial(GL_DIFFUSE, defaultDiffuse);
+        cachedMaterial(GL_AMBIENT, defaultAmbient);
+        cachedMaterial(GL_SPECULAR, defaultSpecular);
+        cachedMaterial(GL_EMISSION, defaultEmission);
+        cachedMaterial(GL_SHININESS, &defaultShininess);
+    }
+}
+
+// Texture a model is drawn with this frame (0 until its image is uploaded)
+GLuint drawTexture(const Model& model) {
+    if (model.textureID > 0 && !model.textureFile.empty() && isTextureReady(model.textureID)) {
+        return model.textureID;
+    }
+    return 0;
+}
+
+} // namespace
+
+void queueModelDraw(std::vector<DrawItem>& queue, const Scene& scene, unsigned model, unsigned level,
+                    const float* modelView, float far) {
+    const Mesh& mesh = meshLevel(*scene.models[model].mesh, level);
+
+    // The eye looks down -z, so the node's depth is minus its eye-space z
+    float depth = far > 0.0f ? -modelView[14] / far : 0.0f;
+    depth = std::min(std::max(depth, 0.0f), 1.0f);
+
+    uint64_t texture = std::min<uint64_t>(drawTexture(scene.models[model]), 0xFFFF);
+    uint64_t material = std::min<uint64_t>(scene.materialIds[model], 0xFFFF);
+    uint64_t meshKey = mesh.vbo & 0xFFFFF;
+    uint64_t depthKey = static_cast<uint64_t>(depth * 4095.0f);
+
+    DrawItem item;
+    item.key = (texture << 48) | (material << 32) | (meshKey << 12) | depthKey;
+    item.model = model;
+    item.level = level;
+    item.modelView = modelView;
+    queue.push_back(item);
+}
+
+RenderStateStats submitRenderQueue(std::vector<DrawItem>& queue, const Scene& scene, bool sort) {
+    RenderStateStats stats;
+    if (queue.empty()) return stats;
+
+    if (sort) {
+        std::sort(queue.begin(), queue.end(), [](const DrawItem& a, const DrawItem& b) {
+            return a.key < b.key;
+        });
+    }
+
+    // Disable color material mode first
+    cachedEnable(GL_COLOR_MATERIAL, false);
+
+    // Nothing is assumed about the state on entry, so the first draw sets it all
+    bool first = true;
+    GLuint currentTexture = 0;
+    unsigned currentMaterial = 0;
+    const Mesh* currentMesh = nullptr;
+    const float* currentModelView = nullptr;
+    for (const DrawItem& item : queue) {
+        const Model& model = scene.models[item.model];
+        const Mesh* mesh = &meshLevel(*model.mesh, item.level);
+
+        GLuint texture = drawTexture(model);
+        if (first || texture != currentTexture) {
+            if (texture != 0) {
+                cachedEnable(GL_TEXTURE_2D, true);
+                cachedBindTexture(texture);
+            } else {
+                cachedEnable(GL_TEXTURE_2D, false);
+            }
+            currentTexture = texture;
+            stats.textureChanges++;
+        }
+
+        unsigned material = scene.materialIds[item.model];
+        if (first || material != currentMaterial) {
+            applyMaterial(scene.materials[item.model]);
+            currentMaterial = material;
+            stats.materialChanges++;
+        }
+
+        if (mesh != currentMesh) {
+            // One bind sets up the whole vertex layout (see bindMeshArrays)
+            bindMeshArrays(*mesh);
+            if (mesh->normalOffset < 0) {
+                // No normals available - use a default normal
+                glNormal3f(0.0f, 1.0f, 0.0f);
+            }
+            currentMesh = mesh;
+            stats.meshChanges++;
+        }
+
+        if (item.modelView != currentModelView) {
+            glLoadMatrixf(item.modelView);
+            currentModelView = item.modelView;
+            stats.matrixLoads++;
+        }
+        first = false;
+
+        // Quantized positions are integer steps around the mesh centre
+        if (mesh->quantized) {
+            glPushMatrix();
+            glTranslatef(mesh->positionOffset[0], mesh->positionOffset[1], mesh->positionOffset[2]);
+            glScalef(mesh->positionScale, mesh->positionScale, mesh->positionScale);
+        }
+
+        if (mesh->ibo != 0) {
+            glDrawElements(GL_TRIANGLES, mesh->indexCount, GL_UNSIGNED_INT, 0);
+        } else {
+            glDrawArrays(GL_TRIANGLES, 0, mesh->vertexCount);
+        }
+        stats.draws++;
+
+        if (mesh->quantized) glPopMatrix();
+    }
+
+    queue.clear();
+    return stats;
+}
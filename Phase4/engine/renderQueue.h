@@ -0,0 +1,67 @@
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include "engine.h"
+#include <cstdint>
+#include <vector>
+
+/**
+ * @file renderQueue.h
+ * @brief Draws models one at a time, sorted to change GL state as rarely as possible
+ *
+ * The scene sweep queues every visible model with a 64-bit sort key
+ * instead of drawing it in scene-graph order. The key holds, from the
+ * most significant bits down:
+ *
+ *   texture (16) | material (16) | mesh (20) | depth (12)
+ *
+ * so sorting groups the models that share a texture, then a material,
+ * then a mesh, and draws each group front to back for early depth
+ * rejection. When submitting, the texture, material and vertex arrays are
+ * only changed when they differ from the previous draw.
+ *
+ * Used when models are not drawn with instancing (see instancing.h).
+ */
+
+// A visible model waiting to be drawn
+struct DrawItem {
+    uint64_t key;
+    unsigned model;             // Index in Scene::models
+    unsigned level;             // Level of detail to draw (see lod.h)
+    const float* modelView;     // Its node's cached model-view matrix
+};
+
+// GL state changes made by the last submitRenderQueue (or drawInstancedModels)
+struct RenderStateStats {
+    int draws = 0;
+    int textureChanges = 0;     // Texture bound or texturing switched off
+    int materialChanges = 0;    // glMaterial calls for a new material
+    int meshChanges = 0;        // Vertex arrays bound for a new mesh
+    int matrixLoads = 0;        // glLoadMatrixf for a new node
+    int programChanges = 0;     // glUseProgram for the instancing shader
+};
+
+/**
+ * @brief Queues a visible model
+ *
+ * @param queue Draws of this frame
+ * @param scene The scene
+ * @param model Index of the model (its mesh must be uploaded)
+ * @param level Level of detail to draw
+ * @param modelView Model-view matrix of the model's node
+ * @param far Far plane distance, the depth that maps to the largest key
+ */
+void queueModelDraw(std::vector<DrawItem>& queue, const Scene& scene, unsigned model, unsigned level,
+                    const float* modelView, float far);
+
+/**
+ * @brief Draws the queued models and empties the queue
+ *
+ * @param queue Draws of this frame
+ * @param scene The scene
+ * @param sort Sort by key first; false keeps the queued order
+ * @return Draws issued and state changes made
+ */
+RenderStateStats submitRenderQueue(std::vector<DrawItem>& queue, const Scene& scene, bool sort);
+
+#endif // RENDER_QUEUE_H
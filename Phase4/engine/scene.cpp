@@ -0,0 +1,392 @@
+/**
+ * @file scene.cpp
+ * @brief Building and updating the flattened scene graph
+ */
+
+#include "scene.h"
+#include "catmullrom.h"
+#include "jobSystem.h"
+#include "matrix.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// Smallest subtree worth a job of its own in the update passes
+const size_t MIN_UPDATE_RANGE_NODES = 64;
+
+/**
+ * @brief Grows a bounding sphere to also enclose another one
+ *
+ * @param sphere Centre and radius, grown in place (negative radius if empty)
+ * @param other Sphere to enclose
+ */
+void mergeSphere(float* sphere, const float* other) {
+    if (other[3] < 0) return;
+    if (sphere[3] < 0) {
+        std::copy(other, other + 4, sphere);
+        return;
+    }
+    float d[3] = {other[0] - sphere[0], other[1] - sphere[1], other[2] - sphere[2]};
+    float distance = std::sqrt(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+    if (distance + other[3] <= sphere[3]) return;
+    if (distance + sphere[3] <= other[3]) {
+        std::copy(other, other + 4, sphere);
+        return;
+    }
+    // Smallest sphere through the far sides of both
+    float radius = (distance + sphere[3] + other[3]) * 0.5f;
+    float t = (radius - sphere[3]) / distance;
+    for (int k = 0; k < 3; k++) sphere[k] += d[k] * t;
+    sphere[3] = radius;
+}
+
+/**
+ * @brief Places a sphere with a matrix and merges it into a bounding sphere
+ *
+ * @param sphere Sphere grown in place
+ * @param m Matrix placing the other sphere
+ * @param center Centre of the other sphere
+ * @param radius Radius of the other sphere
+ */
+void mergePlacedSphere(float* sphere, const float* m, const float* center, float radius) {
+    float placed[4];
+    mat4TransformPoint(m, center, placed);
+    placed[3] = radius * mat4MaxScale(m);
+    mergeSphere(sphere, placed);
+}
+
+/**
+ * @brief Fits a bounding sphere to the polyline drawn for a curve
+ *
+ * @param curve The curve, with its polyline tessellated (not empty)
+ * @param sphere Receives the centre and radius
+ */
+void fitCurveBound(const CatmullRomCurve& curve, float* sphere) {
+    const std::vector<Point>& polyline = curve.polyline;
+    float boxMin[3] = {polyline[0].x, polyline[0].y, polyline[0].z};
+    float boxMax[3] = {polyline[0].x, polyline[0].y, polyline[0].z};
+    for (const Point& p : polyline) {
+        const float v[3] = {p.x, p.y, p.z};
+        for (int k = 0; k < 3; k++) {
+            boxMin[k] = std::min(boxMin[k], v[k]);
+            boxMax[k] = std::max(boxMax[k], v[k]);
+        }
+    }
+    float maxSquared = 0.0f;
+    for (int k = 0; k < 3; k++) sphere[k] = (boxMin[k] + boxMax[k]) * 0.5f;
+    for (const Point& p : polyline) {
+        float dx = p.x - sphere[0], dy = p.y - sphere[1], dz = p.z - sphere[2];
+        maxSquared = std::max(maxSquared, dx * dx + dy * dy + dz * dz);
+    }
+    sphere[3] = std::sqrt(maxSquared);
+}
+
+bool sameColor(const Color& a, const Color& b) {
+    return a.r == b.r && a.g == b.g && a.b == b.b;
+}
+
+bool sameMaterial(const Material& a, const Material& b) {
+    return sameColor(a.diffuse, b.diffuse) && sameColor(a.ambient, b.ambient) &&
+           sameColor(a.specular, b.specular) && sameColor(a.emissive, b.emissive) &&
+           a.shininess == b.shininess;
+}
+
+} // namespace
+
+int addSceneNode(Scene& scene, int parent) {
+    SceneNode node;
+    node.parent = parent;
+    node.firstOp = static_cast<unsigned>(scene.transformOps.size());
+    node.firstModel = static_cast<unsigned>(scene.models.size());
+    scene.nodes.push_back(node);
+    scene.nodeFlags.push_back(NODE_DIRTY);
+
+    size_t matrixFloats = scene.nodes.size() * 16;
+    scene.localMatrices.resize(matrixFloats);
+    scene.worldMatrices.resize(matrixFloats);
+    scene.modelViewMatrices.resize(matrixFloats);
+    scene.subtreeBounds.resize(scene.nodes.size() * 4);
+    scene.subtreeBounds.back() = -1.0f;
+    return static_cast<int>(scene.nodes.size() - 1);
+}
+
+void closeSceneNode(Scene& scene, int node) {
+    scene.nodes[node].subtreeEnd = static_cast<unsigned>(scene.nodes.size());
+}
+
+void addTransformOp(Scene& scene, TransformOpType type, const float* params, size_t count) {
+    TransformOp op;
+    op.type = type;
+    op.param = static_cast<unsigned>(scene.transformParams.size());
+    scene.transformParams.insert(scene.transformParams.end(), params, params + count);
+    scene.transformOps.push_back(op);
+    scene.nodes.back().opCount++;
+    if (type == OP_ROTATE_TIME) {
+        scene.nodeFlags.back() |= NODE_ANIMATED;
+    }
+}
+
+void addSceneCurve(Scene& scene, const CatmullRomCurve& curve) {
+    TransformOp op;
+    op.type = OP_TRANSLATE_CURVE;
+    op.param = static_cast<unsigned>(scene.curves.size());
+    scene.curves.push_back(curve);
+    buildCatmullRomSegments(scene.curves.back());
+    scene.transformOps.push_back(op);
+    scene.nodes.back().opCount++;
+    scene.nodes.back().curve = static_cast<int>(op.param);
+    scene.nodeFlags.back() |= NODE_ANIMATED;
+
+    float sphere[4] = {0.0f, 0.0f, 0.0f, -1.0f};
+    if (curve.draw && curve.points.size() >= 4) {
+        tessellateCatmullRomCurve(scene.curves.back());
+        fitCurveBound(scene.curves.back(), sphere);
+    }
+    scene.curveBounds.insert(scene.curveBounds.end(), sphere, sphere + 4);
+}
+
+void addSceneModel(Scene& scene, const Model& model, const Material& material) {
+    // Equal materials share an id; a new material takes the next one
+    auto same = std::find_if(scene.materials.begin(), scene.materials.end(),
+                             [&material](const Material& other) { return sameMaterial(other, material); });
+    unsigned materialId;
+    if (same != scene.materials.end()) {
+        materialId = scene.materialIds[same - scene.materials.begin()];
+    } else {
+        materialId = scene.materialIds.empty() ? 0 : *std::max_element(scene.materialIds.begin(), scene.materialIds.end()) + 1;
+    }
+
+    scene.models.push_back(model);
+    scene.materials.push_back(material);
+    scene.materialIds.push_back(materialId);
+    scene.modelVisible.push_back(1);
+    scene.modelLod.push_back(0);
+    scene.nodes.back().modelCount++;
+}
+
+namespace {
+
+/**
+ * @brief Builds the local matrix of a node from its transform ops
+ * 
+ * @param scene The scene
+ * @param node The node
+ * @param elapsed Animation time in seconds
+ * @param m Receives the matrix
+ */
+void computeLocalMatrix(const Scene& scene, const SceneNode& node, double elapsed, float* m) {
+    mat4Identity(m);
+    const float* params = scene.transformParams.data();
+    for (unsigned i = node.firstOp; i < node.firstOp + node.opCount; i++) {
+        const TransformOp& op = scene.transformOps[i];
+        const float* p = params + op.param;
+        switch (op.type) {
+            case OP_TRANSLATE:
+                mat4Translate(m, p[0], p[1], p[2]);
+                break;
+            case OP_TRANSLATE_CURVE: {
+                // Evaluated for every curve at once by updateSceneMatrices
+                const CatmullRomCurve& curve = scene.curves[op.param];
+                const CatmullRomSamples& samples = scene.curveSamples;
+                float pos[3] = {samples.x[op.param], samples.y[op.param], samples.z[op.param]};
+                float deriv[3] = {samples.dx[op.param], samples.dy[op.param], samples.dz[op.param]};
+                mat4Translate(m, pos[0], pos[1], pos[2]);
+                if (curve.align) {
+                    float up[3] = {0, 1, 0}, side[3], r[16];
+                    cross(deriv, up, side);
+                    normalize(deriv); normalize(side);
+                    cross(side, deriv, up);
+                    buildRotMatrix(deriv, up, side, r);
+                    mat4PostMultiply(m, r);
+                }
+                break;
+            }
+            case OP_ROTATE:
+                if (p[0] != 0.0f)
+                    mat4Rotate(m, p[0], p[1], p[2], p[3]);
+                break;
+            case OP_ROTATE_TIME: {
+                float angle = static_cast<float>(fmod(elapsed / p[0], 1.0)) * 360.0f;
+                mat4Rotate(m, angle, p[1], p[2], p[3]);
+                break;
+            }
+            case OP_SCALE:
+                mat4Scale(m, p[0], p[1], p[2]);
+                break;
+        }
+    }
+}
+
+/**
+ * @brief Rebuilds the matrices of one node if it or its parent changed
+ *
+ * @param scene The scene, with the parent already updated
+ * @param i Index of the node
+ * @param elapsed Animation time in seconds
+ * @param animate Whether animated nodes rebuild their local matrix
+ * @param identity Identity matrix, the parent world matrix of top-level nodes
+ */
+void updateNodeMatrices(Scene& scene, size_t i, double elapsed, bool animate, const float* identity) {
+    const SceneNode& node = scene.nodes[i];
+    unsigned char& flags = scene.nodeFlags[i];
+
+    bool changed = node.parent >= 0 && (scene.nodeFlags[node.parent] & NODE_WORLD_CHANGED);
+    if ((flags & NODE_DIRTY) || (animate && (flags & NODE_ANIMATED))) {
+        computeLocalMatrix(scene, node, elapsed, localMatrix(scene, i));
+        flags &= ~NODE_DIRTY;
+        changed = true;
+    }
+    if (changed) {
+        const float* parentWorld = node.parent >= 0 ? worldMatrix(scene, node.parent) : identity;
+        mat4Multiply(parentWorld, localMatrix(scene, i), worldMatrix(scene, i));
+        flags |= NODE_WORLD_CHANGED;
+    } else {
+        flags &= ~NODE_WORLD_CHANGED;
+    }
+}
+
+/**
+ * @brief Refits the subtree bound of one node if needed
+ *
+ * Does not flag the parent, so that ranges running concurrently never
+ * write the same node.
+ *
+ * @param scene The scene, with the node's children already refit
+ * @param i Index of the node
+ * @param identity Identity matrix, the parent world matrix of top-level nodes
+ * @return True if the bound changed (the parent needs refitting)
+ */
+bool refitNodeBound(Scene& scene, size_t i, const float* identity) {
+    const SceneNode& node = scene.nodes[i];
+    unsigned char& flags = scene.nodeFlags[i];
+    if (!(flags & (NODE_WORLD_CHANGED | NODE_BOUNDS_DIRTY))) return false;
+    flags &= ~NODE_BOUNDS_DIRTY;
+
+    float sphere[4] = {0.0f, 0.0f, 0.0f, -1.0f};
+    const float* world = worldMatrix(scene, i);
+    for (unsigned m = node.firstModel; m < node.firstModel + node.modelCount; m++) {
+        const Mesh* mesh = scene.models[m].mesh;
+        if (!mesh || mesh->vertexCount == 0 || mesh->boundsRadius < 0) continue;
+        mergePlacedSphere(sphere, world, mesh->boundsCenter, mesh->boundsRadius);
+    }
+    // The trajectory is drawn in the parent's space
+    if (node.curve >= 0) {
+        const float* curveSphere = &scene.curveBounds[node.curve * 4];
+        if (curveSphere[3] >= 0) {
+            const float* parentWorld = node.parent >= 0 ? worldMatrix(scene, node.parent) : identity;
+            mergePlacedSphere(sphere, parentWorld, curveSphere, curveSphere[3]);
+        }
+    }
+    // Direct children: each subtree is skipped over as a whole
+    for (unsigned child = static_cast<unsigned>(i) + 1; child < node.subtreeEnd;
+         child = scene.nodes[child].subtreeEnd) {
+        mergeSphere(sphere, subtreeBound(scene, child));
+    }
+
+    float* bound = &scene.subtreeBounds[i * 4];
+    if (std::equal(sphere, sphere + 4, bound)) return false;
+    std::copy(sphere, sphere + 4, bound);
+    return true;
+}
+
+/**
+ * @brief Splits the nodes into subtrees that can be updated concurrently
+ *
+ * Subtrees of up to about 1/4 of a thread's share of the nodes become
+ * ranges; the ancestors of larger ones are updated on the calling thread.
+ *
+ * @param scene The scene
+ */
+void planSceneUpdate(Scene& scene) {
+    scene.updateSerialNodes.clear();
+    scene.updateRanges.clear();
+    size_t nodeCount = scene.nodes.size();
+    size_t target = std::max<size_t>(MIN_UPDATE_RANGE_NODES, nodeCount / ((jobWorkerCount() + 1) * 4));
+
+    size_t i = 0;
+    while (i < nodeCount) {
+        size_t end = scene.nodes[i].subtreeEnd;
+        if (end - i <= target) {
+            scene.updateRanges.push_back(static_cast<unsigned>(i));
+            i = end;
+        } else {
+            // Too large: update this node first, then split its children
+            scene.updateSerialNodes.push_back(static_cast<unsigned>(i));
+            i++;
+        }
+    }
+    scene.updateRangeChanged.assign(scene.updateRanges.size(), 0);
+    scene.updatePlanSize = nodeCount;
+}
+
+} // namespace
+
+void updateSceneMatrices(Scene& scene, double elapsed) {
+    float identity[16];
+    mat4Identity(identity);
+    if (scene.updatePlanSize != scene.nodes.size()) planSceneUpdate(scene);
+
+    // While the clock stands still (paused) animated nodes keep their matrices
+    bool animate = elapsed != scene.animationTime;
+    scene.animationTime = elapsed;
+
+    // Every curve moves each frame, so they are evaluated together in one batch
+    size_t curveCount = scene.curves.size();
+    if (animate) {
+        scene.curveParams.resize(curveCount);
+        for (size_t c = 0; c < curveCount; c++) {
+            float time = scene.curves[c].time;
+            scene.curveParams[c] = time > 0.0f ? static_cast<float>(fmod(elapsed / time, 1.0)) : 0.0f;
+        }
+        evalCatmullRomCurves(scene.curves.data(), scene.curveParams.data(), curveCount, scene.curveSamples);
+    }
+
+    // Parents come first, so their world matrices are already up to date:
+    // the ancestors of the ranges, then each range in one job
+    for (unsigned i : scene.updateSerialNodes) {
+        updateNodeMatrices(scene, i, elapsed, animate, identity);
+    }
+    parallelFor(scene.updateRanges.size(), [&](size_t r) {
+        unsigned root = scene.updateRanges[r];
+        for (size_t i = root; i < scene.nodes[root].subtreeEnd; i++) {
+            updateNodeMatrices(scene, i, elapsed, animate, identity);
+        }
+    });
+}
+
+void updateSceneBounds(Scene& scene) {
+    float identity[16];
+    mat4Identity(identity);
+    if (scene.updatePlanSize != scene.nodes.size()) planSceneUpdate(scene);
+
+    // Children come after their parents, so backwards sweeps refit them first:
+    // each range in one job, then their ancestors
+    parallelFor(scene.updateRanges.size(), [&](size_t r) {
+        unsigned root = scene.updateRanges[r];
+        for (size_t i = scene.nodes[root].subtreeEnd; i-- > root;) {
+            if (!refitNodeBound(scene, i, identity)) continue;
+            if (i == root) {
+                scene.updateRangeChanged[r] = 1;
+            } else {
+                scene.nodeFlags[scene.nodes[i].parent] |= NODE_BOUNDS_DIRTY;
+            }
+        }
+    });
+    for (size_t r = 0; r < scene.updateRanges.size(); r++) {
+        if (!scene.updateRangeChanged[r]) continue;
+        scene.updateRangeChanged[r] = 0;
+        int parent = scene.nodes[scene.updateRanges[r]].parent;
+        if (parent >= 0) scene.nodeFlags[parent] |= NODE_BOUNDS_DIRTY;
+    }
+    for (auto it = scene.updateSerialNodes.rbegin(); it != scene.updateSerialNodes.rend(); ++it) {
+        int parent = scene.nodes[*it].parent;
+        if (refitNodeBound(scene, *it, identity) && parent >= 0) {
+            scene.nodeFlags[parent] |= NODE_BOUNDS_DIRTY;
+        }
+    }
+}
+
+void invalidateSceneBounds(Scene& scene) {
+    for (unsigned char& flags : scene.nodeFlags) flags |= NODE_BOUNDS_DIRTY;
+}
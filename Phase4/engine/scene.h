@@ -0,0 +1,117 @@
+#ifndef SCENE_H
+#define SCENE_H
+
+#include "engine.h"
+
+/**
+ * @file scene.h
+ * @brief Building and updating the flattened scene graph (see Scene in engine.h)
+ */
+
+/**
+ * @brief Appends a node to the scene
+ *
+ * Nodes must be added in depth-first order: a node's models and transform
+ * ops are added right after it, before any of its children.
+ *
+ * @param scene Scene being built
+ * @param parent Index of the parent node (-1 for the root)
+ * @return Index of the new node
+ */
+int addSceneNode(Scene& scene, int parent);
+
+/**
+ * @brief Marks the end of a node's subtree, once all its children were added
+ *
+ * @param scene Scene being built
+ * @param node Index of the node
+ */
+void closeSceneNode(Scene& scene, int node);
+
+/**
+ * @brief Appends a transform op to the last node added
+ *
+ * @param scene Scene being built
+ * @param type Kind of op
+ * @param params Parameters of the op (for OP_TRANSLATE_CURVE: none, see addSceneCurve)
+ * @param count Number of parameters
+ */
+void addTransformOp(Scene& scene, TransformOpType type, const float* params, size_t count);
+
+/**
+ * @brief Appends a timed translate along a curve to the last node added
+ *
+ * A drawn curve is tessellated here, once, into the polyline the
+ * trajectory pass uploads (see trajectories.h).
+ *
+ * @param scene Scene being built
+ * @param curve The curve
+ */
+void addSceneCurve(Scene& scene, const CatmullRomCurve& curve);
+
+/**
+ * @brief Appends a model and its material to the last node added
+ *
+ * Equal materials get the same Scene::materialIds entry.
+ *
+ * @param scene Scene being built
+ * @param model The model
+ * @param material Its material
+ */
+void addSceneModel(Scene& scene, const Model& model, const Material& material);
+
+/**
+ * @brief Refreshes the cached local and world matrices of every node
+ *
+ * Only animated nodes rebuild their local matrix, and world matrices are
+ * only recomputed below a node whose matrix changed, so static scenery
+ * costs no matrix math after the first frame. All curves are evaluated
+ * up front in one batch (see evalCatmullRomCurves). When the time is the
+ * same as in the last call (a paused clock) animated nodes are left as is.
+ *
+ * Subtrees are updated concurrently on the job workers (see parallelFor)
+ * once their ancestors are done; small scenes stay on the calling thread.
+ *
+ * @param scene The scene
+ * @param elapsed Animation time in seconds (see frameClock.h)
+ */
+void updateSceneMatrices(Scene& scene, double elapsed);
+
+/**
+ * @brief Refits the subtree bounding spheres after a matrix update
+ *
+ * A sweep from the last node to the first, so children are refit before
+ * their parents. Only nodes whose world matrix changed, or below which a
+ * bound changed, are recomputed: a moving moon refits its own sphere and
+ * those of its ancestors, while static scenery costs one flag check.
+ * Split into the same concurrent subtrees as updateSceneMatrices.
+ *
+ * @param scene The scene, with matrices updated for this frame
+ */
+void updateSceneBounds(Scene& scene);
+
+/**
+ * @brief Marks every subtree bound for refitting
+ *
+ * Needed whenever a mesh finishes loading, since the bounds only cover
+ * meshes that are ready to draw.
+ *
+ * @param scene The scene
+ */
+void invalidateSceneBounds(Scene& scene);
+
+// One past the last model of a node's subtree (its models are contiguous from firstModel)
+inline unsigned subtreeModelEnd(const Scene& scene, size_t node) {
+    unsigned end = scene.nodes[node].subtreeEnd;
+    return end < scene.nodes.size() ? scene.nodes[end].firstModel : static_cast<unsigned>(scene.models.size());
+}
+
+// Cached matrices of a node (16 floats, column-major)
+inline float* localMatrix(Scene& scene, size_t node) { return &scene.localMatrices[node * 16]; }
+inline float* worldMatrix(Scene& scene, size_t node) { return &scene.worldMatrices[node * 16]; }
+inline float* modelViewMatrix(Scene& scene, size_t node) { return &scene.modelViewMatrices[node * 16]; }
+
+// World-space bounding sphere of a node's subtree (centre xyz, radius)
+inline const float* subtreeBound(const Scene& scene, size_t node) { return &scene.subtreeBounds[node * 4]; }
+
+#endif // SCENE_H
@@ -1,4 +1,5 @@
 #include "texture.h"
+#include "glStateCache.h"
 
 // Platform-specific OpenGL includes
 #define GL_SILENCE_DEPRECATION
@@ -18,10 +19,97 @@
 
 
 
+#include "jobSystem.h"
+#include "pathUtils.h"
+#include <algorithm>
+#include <cstring>
 #include <iostream>
 #include <fstream>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
 
-GLuint loadTexture(const std::string& filename) {
+// Anisotropic filtering (GL_EXT_texture_filter_anisotropic), not in every gl.h
+#ifndef GL_TEXTURE_MAX_ANISOTROPY_EXT
+#define GL_TEXTURE_MAX_ANISOTROPY_EXT 0x84FE
+#endif
+#ifndef GL_MAX_TEXTURE_MAX_ANISOTROPY_EXT
+#define GL_MAX_TEXTURE_MAX_ANISOTROPY_EXT 0x84FF
+#endif
+
+namespace {
+
+// A texture resident on the GPU
+struct CachedTexture {
+    std::string path;     // Cache key: canonical path plus sampling settings
+    GLuint id = 0;
+    int refCount = 0;
+    size_t bytes = 0;     // RGBA8 size of all uploaded mip levels
+    bool ready = false;   // Image uploaded (false while loading or after a failed load)
+    bool pending = true;  // Load job not finished yet
+    unsigned loadId = 0;  // Identifies the load job that fills this texture
+};
+
+// Image decoded by a load job: level 0 plus the mip chain when mipmapped
+struct DecodedImage {
+    std::vector<MipLevel> levels;  // Empty if decoding failed
+};
+
+// Resident textures by canonical path, plus a reverse index for releaseTexture
+std::unordered_map<std::string, CachedTexture> texturesByPath;
+std::unordered_map<GLuint, std::string> pathsById;
+TextureCacheStats stats;
+unsigned nextLoadId = 0;
+
+// DevIL keeps global state (bound image, error stack), so decoding is serialized
+std::mutex devilMutex;
+
+// Largest anisotropy the GPU supports (1 if the extension is missing)
+float maxSupportedAnisotropy() {
+    static float maxAnisotropy = 0.0f;
+    if (maxAnisotropy == 0.0f) {
+        maxAnisotropy = 1.0f;
+        const char* extensions = reinterpret_cast<const char*>(glGetString(GL_EXTENSIONS));
+        if (extensions && std::strstr(extensions, "GL_EXT_texture_filter_anisotropic")) {
+            glGetFloatv(GL_MAX_TEXTURE_MAX_ANISOTROPY_EXT, &maxAnisotropy);
+        }
+    }
+    return maxAnisotropy;
+}
+
+// Sets the filtering parameters of the bound texture
+void applySampling(const TextureSampling& sampling, int mipLevels) {
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    switch (sampling.filter) {
+        case FILTER_TRILINEAR:
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+            break;
+        case FILTER_BILINEAR:
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_NEAREST);
+            break;
+        default:
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+            break;
+    }
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, mipLevels - 1);
+
+    if (sampling.anisotropy > 1.0f) {
+        float anisotropy = std::min(sampling.anisotropy, maxSupportedAnisotropy());
+        if (anisotropy > 1.0f) {
+            glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAX_ANISOTROPY_EXT, anisotropy);
+        }
+    }
+}
+
+// Cache key of a texture: the same file with different sampling is a different GL texture
+std::string textureKey(const std::string& path, const TextureSampling& sampling) {
+    return path + "|" + std::to_string(static_cast<int>(sampling.filter)) +
+           "|" + std::to_string(sampling.anisotropy);
+}
+
+// Decodes an image with DevIL into RGBA8 level 0 (worker thread); false on failure
+bool decodeImage(const std::string& filename, MipLevel& image) {
+    std::lock_guard<std::mutex> lock(devilMutex);
     std::cout << "Loading texture from: " << filename << std::endl;
     
     static bool devilInitialized = false;
@@ -32,12 +120,9 @@ GLuint loadTexture(const std::string& filename) {
         ilEnable(IL_ORIGIN_SET);
         ilOriginFunc(IL_ORIGIN_LOWER_LEFT);
         devilInitialized = true;
-        std::cout << "DevIL initialized successfully" << std::endl;
+        std::cout << "DevIL initialized successfully (version " << ilGetInteger(IL_VERSION_NUM) << ")" << std::endl;
     }
 
-    // Print DevIL version
-    std::cout << "DevIL version: " << ilGetInteger(IL_VERSION_NUM) << std::endl;
-
     ILuint img;
     ilGenImages(1, &img);
     ilBindImage(img);
@@ -47,7 +132,7 @@ GLuint loadTexture(const std::string& filename) {
     if (!file.is_open()) {
         std::cerr << "Error: Texture file not found: " << filename << std::endl;
         ilDeleteImages(1, &img);
-        return 0;
+        return false;
     }
     file.close();
 
@@ -57,29 +142,185 @@ GLuint loadTexture(const std::string& filename) {
         std::cerr << "DevIL failed to load image: " << filename << std::endl;
         std::cerr << "DevIL error code: " << error << std::endl;
         ilDeleteImages(1, &img);
-        return 0;
+        return false;
     }
 
     std::cout << "Image loaded successfully, converting to RGBA format" << std::endl;
     ilConvertImage(IL_RGBA, IL_UNSIGNED_BYTE);
 
-    int width = ilGetInteger(IL_IMAGE_WIDTH);
-    int height = ilGetInteger(IL_IMAGE_HEIGHT);
-    unsigned char* data = ilGetData();
+    image.width = ilGetInteger(IL_IMAGE_WIDTH);
+    image.height = ilGetInteger(IL_IMAGE_HEIGHT);
+    const unsigned char* data = ilGetData();
+    image.pixels.assign(data, data + static_cast<size_t>(image.width) * image.height * 4);
 
-    std::cout << "Image dimensions: " << width << "x" << height << std::endl;
+    std::cout << "Image dimensions: " << image.width << "x" << image.height << std::endl;
 
-    GLuint texID;
-    glGenTextures(1, &texID);
-    glBindTexture(GL_TEXTURE_2D, texID);
+    ilDeleteImages(1, &img);
+    return true;
+}
+
+// Uploads every level of a decoded image into a texture (GLUT thread); returns the bytes uploaded
+size_t uploadImage(GLuint texID, const TextureSampling& sampling, const DecodedImage& image) {
+    cachedBindTexture(texID);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
 
-    std::cout << "Texture created with ID: " << texID << std::endl;
+    size_t bytes = 0;
+    int mipLevels = 0;
+    for (const MipLevel& level : image.levels) {
+        glTexImage2D(GL_TEXTURE_2D, mipLevels, GL_RGBA, level.width, level.height, 0,
+                     GL_RGBA, GL_UNSIGNED_BYTE, level.pixels.data());
+        bytes += level.pixels.size();
+        mipLevels++;
+    }
+    applySampling(sampling, mipLevels);
+    cachedBindTexture(0);
 
-    ilDeleteImages(1, &img);
+    std::cout << "Texture created with ID: " << texID << " (" << mipLevels << " mip levels)" << std::endl;
+    return bytes;
+}
+
+/**
+ * @brief Finishes a texture load job on the GLUT thread
+ *
+ * Dropped if the texture was released (or released and loaded again)
+ * while the job ran.
+ *
+ * @param key Cache key of the texture
+ * @param loadId Load job that produced the image
+ * @param sampling Sampler settings of the texture
+ * @param image Decoded image (no levels if decoding failed)
+ * @return Bytes uploaded
+ */
+size_t finishTexture(const std::string& key, unsigned loadId, const TextureSampling& sampling,
+                     const DecodedImage& image) {
+    auto it = texturesByPath.find(key);
+    if (it == texturesByPath.end() || it->second.loadId != loadId) return 0;
+
+    CachedTexture& texture = it->second;
+    texture.pending = false;
+    stats.pending--;
+    if (image.levels.empty()) return 0;
+
+    texture.bytes = uploadImage(texture.id, sampling, image);
+    texture.ready = true;
+    stats.totalBytes += texture.bytes;
+    return texture.bytes;
+}
+
+} // namespace
+
+std::vector<MipLevel> buildMipChain(const unsigned char* pixels, int width, int height) {
+    std::vector<MipLevel> levels;
+    const unsigned char* src = pixels;
+    int srcWidth = width;
+    int srcHeight = height;
+
+    while (srcWidth > 1 || srcHeight > 1) {
+        MipLevel level;
+        level.width = std::max(1, srcWidth / 2);
+        level.height = std::max(1, srcHeight / 2);
+        level.pixels.resize(static_cast<size_t>(level.width) * level.height * 4);
+
+        // Average each 2x2 block; odd edges reuse the last row/column
+        for (int y = 0; y < level.height; y++) {
+            int y0 = std::min(2 * y, srcHeight - 1);
+            int y1 = std::min(2 * y + 1, srcHeight - 1);
+            for (int x = 0; x < level.width; x++) {
+                int x0 = std::min(2 * x, srcWidth - 1);
+                int x1 = std::min(2 * x + 1, srcWidth - 1);
+                const unsigned char* p00 = src + (static_cast<size_t>(y0) * srcWidth + x0) * 4;
+                const unsigned char* p01 = src + (static_cast<size_t>(y0) * srcWidth + x1) * 4;
+                const unsigned char* p10 = src + (static_cast<size_t>(y1) * srcWidth + x0) * 4;
+                const unsigned char* p11 = src + (static_cast<size_t>(y1) * srcWidth + x1) * 4;
+                unsigned char* dst = &level.pixels[(static_cast<size_t>(y) * level.width + x) * 4];
+                for (int c = 0; c < 4; c++) {
+                    dst[c] = static_cast<unsigned char>((p00[c] + p01[c] + p10[c] + p11[c] + 2) / 4);
+                }
+            }
+        }
+
+        levels.push_back(std::move(level));
+        const MipLevel& last = levels.back();
+        src = last.pixels.data();
+        srcWidth = last.width;
+        srcHeight = last.height;
+    }
+    return levels;
+}
+
+GLuint loadTexture(const std::string& filename, const TextureSampling& sampling) {
+    std::string key = textureKey(canonicalPath(filename), sampling);
+
+    auto it = texturesByPath.find(key);
+    if (it != texturesByPath.end()) {
+        it->second.refCount++;
+        stats.hits++;
+        return it->second.id;
+    }
+
+    stats.misses++;
+
+    // The ID is handed out right away; the image is decoded on the worker
+    // pool and uploaded by processUploads once it is ready
+    GLuint texID;
+    glGenTextures(1, &texID);
+
+    CachedTexture& texture = texturesByPath[key];
+    texture.path = key;
+    texture.id = texID;
+    texture.refCount = 1;
+    texture.loadId = ++nextLoadId;
+    pathsById[texID] = key;
+    stats.textureCount++;
+    stats.pending++;
+
+    unsigned loadId = texture.loadId;
+    submitJob([filename, key, loadId, sampling]() {
+        std::shared_ptr<DecodedImage> image(new DecodedImage());
+        MipLevel base;
+        if (decodeImage(filename, base)) {
+            std::vector<MipLevel> mips;
+            if (sampling.filter != FILTER_LINEAR) {
+                mips = buildMipChain(base.pixels.data(), base.width, base.height);
+            }
+            image->levels.reserve(mips.size() + 1);
+            image->levels.push_back(std::move(base));
+            for (MipLevel& level : mips) {
+                image->levels.push_back(std::move(level));
+            }
+        }
+        postUpload([key, loadId, sampling, image]() {
+            return finishTexture(key, loadId, sampling, *image);
+        });
+    });
     return texID;
+}
+
+bool isTextureReady(GLuint textureID) {
+    auto idIt = pathsById.find(textureID);
+    if (idIt == pathsById.end()) return false;
+    auto it = texturesByPath.find(idIt->second);
+    return it != texturesByPath.end() && it->second.ready;
+}
+
+void releaseTexture(GLuint textureID) {
+    auto idIt = pathsById.find(textureID);
+    if (idIt == pathsById.end()) return;
+
+    auto it = texturesByPath.find(idIt->second);
+    if (--it->second.refCount > 0) return;
+
+    glDeleteTextures(1, &textureID);
+    forgetCachedTexture(textureID);
+    if (it->second.pending) stats.pending--;
+    stats.textureCount--;
+    stats.totalBytes -= it->second.bytes;
+    texturesByPath.erase(it);
+    pathsById.erase(idIt);
+}
+
+TextureCacheStats getTextureCacheStats() {
+    return stats;
 }
\ No newline at end of file
@@ -8,9 +8,46 @@
 #include <GL/gl.h>
 #endif
 
+#include <cstddef>
 #include <string>
+#include <vector>
+#include "textureSampling.h"
 
-// Load a texture from a file and return the OpenGL texture ID
-unsigned int loadTexture(const std::string& filename);
+// One level of a mipmap chain (RGBA8 pixels)
+struct MipLevel {
+    int width = 0;
+    int height = 0;
+    std::vector<unsigned char> pixels;
+};
+
+// Builds mip levels 1..N for an RGBA8 image with a 2x2 box filter (level 0 is the image itself)
+std::vector<MipLevel> buildMipChain(const unsigned char* pixels, int width, int height);
+
+// Load a texture from a file and return the OpenGL texture ID.
+// Textures are cached by canonical path and sampling settings: loading the same
+// file again returns the existing ID and adds a reference that must be dropped
+// with releaseTexture.
+// The image is decoded on the worker pool (see jobSystem.h) and uploaded later
+// by processUploads; until then isTextureReady returns false.
+unsigned int loadTexture(const std::string& filename, const TextureSampling& sampling = TextureSampling());
+
+// True once the image of a texture returned by loadTexture has been uploaded
+bool isTextureReady(unsigned int textureID);
+
+// Drop a reference to a texture returned by loadTexture; the GL texture is
+// deleted when the last reference is released
+void releaseTexture(unsigned int textureID);
+
+// Counters describing the texture cache
+struct TextureCacheStats {
+    size_t hits = 0;          // loadTexture calls served from the cache
+    size_t misses = 0;        // loadTexture calls that decoded a file
+    size_t textureCount = 0;  // Textures currently resident
+    size_t pending = 0;       // Textures still being decoded or waiting for upload
+    size_t totalBytes = 0;    // Approximate GPU memory used by resident textures
+};
+
+// Current texture cache statistics
+TextureCacheStats getTextureCacheStats();
 
 #endif // TEXTURE_H
\ No newline at end of file
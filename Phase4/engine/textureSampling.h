@@ -0,0 +1,17 @@
+#ifndef TEXTURE_SAMPLING_H
+#define TEXTURE_SAMPLING_H
+
+// Minification filter of a texture (selected with the filter attribute of <texture>)
+enum TextureFilter {
+    FILTER_LINEAR,     // "linear": no mipmaps, bilinear sampling of level 0
+    FILTER_BILINEAR,   // "bilinear": mipmaps, bilinear within the nearest level
+    FILTER_TRILINEAR   // "trilinear": mipmaps, blends between the two nearest levels
+};
+
+// Sampler configuration of a texture
+struct TextureSampling {
+    TextureFilter filter = FILTER_TRILINEAR;
+    float anisotropy = 1.0f;  // Max anisotropy (1 = off), clamped to what the GPU supports
+};
+
+#endif // TEXTURE_SAMPLING_H
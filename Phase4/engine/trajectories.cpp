@@ -0,0 +1,105 @@
+/**
+ * @file trajectories.cpp
+ * @brief Debug-line pass that draws the trajectories of curve translates
+ */
+
+#include "trajectories.h"
+#include "glStateCache.h"
+#include "scene.h"
+#include <algorithm>
+#include <vector>
+
+namespace {
+
+GLuint lineBuffer = 0;
+
+// First vertex and vertex count of each curve's polyline in lineBuffer (count 0 if not drawn)
+std::vector<GLint> curveFirst;
+std::vector<GLsizei> curveCount;
+
+// Scratch for the ranges of one glMultiDrawArrays
+std::vector<GLint> batchFirst;
+std::vector<GLsizei> batchCount;
+
+} // namespace
+
+void uploadTrajectories(const Scene& scene) {
+    releaseTrajectories();
+
+    std::vector<float> vertices;
+    curveFirst.assign(scene.curves.size(), 0);
+    curveCount.assign(scene.curves.size(), 0);
+    for (size_t c = 0; c < scene.curves.size(); c++) {
+        const std::vector<Point>& polyline = scene.curves[c].polyline;
+        curveFirst[c] = static_cast<GLint>(vertices.size() / 3);
+        curveCount[c] = static_cast<GLsizei>(polyline.size());
+        for (const Point& p : polyline) {
+            vertices.push_back(p.x);
+            vertices.push_back(p.y);
+            vertices.push_back(p.z);
+        }
+    }
+    if (vertices.empty()) return;
+
+    glGenBuffers(1, &lineBuffer);
+    cachedBindBuffer(GL_ARRAY_BUFFER, lineBuffer);
+    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_STATIC_DRAW);
+    cachedBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void releaseTrajectories() {
+    if (lineBuffer != 0) {
+        glDeleteBuffers(1, &lineBuffer);
+        forgetCachedBuffer(lineBuffer);
+        lineBuffer = 0;
+    }
+    curveFirst.clear();
+    curveCount.clear();
+}
+
+int drawTrajectories(Scene& scene, std::vector<unsigned>& nodes, const float* viewMatrix) {
+    if (lineBuffer == 0 || nodes.empty()) return 0;
+
+    // Siblings share a model-view matrix: group them so each parent is one call
+    std::stable_sort(nodes.begin(), nodes.end(), [&scene](unsigned a, unsigned b) {
+        return scene.nodes[a].parent < scene.nodes[b].parent;
+    });
+
+    bool lightingEnabled = cachedIsEnabled(GL_LIGHTING);
+    cachedEnable(GL_LIGHTING, false);
+    cachedEnable(GL_TEXTURE_2D, false);
+    glColor3f(0.7f, 0.7f, 0.7f); // Light gray for trajectory
+
+    // Runs after unbindMeshArrays, on the default vertex array object
+    cachedClientState(GL_NORMAL_ARRAY, false);
+    cachedClientState(GL_TEXTURE_COORD_ARRAY, false);
+    cachedBindBuffer(GL_ARRAY_BUFFER, lineBuffer);
+    cachedClientState(GL_VERTEX_ARRAY, true);
+    glVertexPointer(3, GL_FLOAT, 0, nullptr);
+
+    int drawCalls = 0;
+    size_t i = 0;
+    while (i < nodes.size()) {
+        int parent = scene.nodes[nodes[i]].parent;
+        batchFirst.clear();
+        batchCount.clear();
+        for (; i < nodes.size() && scene.nodes[nodes[i]].parent == parent; i++) {
+            int curve = scene.nodes[nodes[i]].curve;
+            if (curveCount[curve] == 0) continue;
+            batchFirst.push_back(curveFirst[curve]);
+            batchCount.push_back(curveCount[curve]);
+        }
+        if (batchFirst.empty()) continue;
+
+        glLoadMatrixf(parent >= 0 ? modelViewMatrix(scene, parent) : viewMatrix);
+        glMultiDrawArrays(GL_LINE_LOOP, batchFirst.data(), batchCount.data(),
+                          static_cast<GLsizei>(batchFirst.size()));
+        drawCalls++;
+    }
+
+    cachedClientState(GL_VERTEX_ARRAY, false);
+    cachedBindBuffer(GL_ARRAY_BUFFER, 0);
+    if (lightingEnabled) cachedEnable(GL_LIGHTING, true);
+    glColor3f(1.0f, 1.0f, 1.0f); // Reset color
+    return drawCalls;
+}
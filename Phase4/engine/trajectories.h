@@ -0,0 +1,42 @@
+#ifndef TRAJECTORIES_H
+#define TRAJECTORIES_H
+
+#include "engine.h"
+
+/**
+ * @file trajectories.h
+ * @brief Debug-line pass that draws the trajectories of curve translates
+ *
+ * Every drawn curve is tessellated once when the scene is built (see
+ * tessellateCatmullRomCurve) and the polylines are packed into a single
+ * vertex buffer. Each frame the trajectories of the groups that survived
+ * culling are drawn after the scene, with one glMultiDrawArrays per
+ * parent group, since a trajectory lies in its parent's space.
+ */
+
+/**
+ * @brief Uploads the polylines of every drawn curve to the line buffer
+ *
+ * Call once after glewInit, when the scene is fully parsed.
+ *
+ * @param scene The scene
+ */
+void uploadTrajectories(const Scene& scene);
+
+// Frees the line buffer
+void releaseTrajectories();
+
+/**
+ * @brief Draws the trajectories of the given nodes
+ *
+ * Uses the model-view matrices cached in the scene, so the parents of the
+ * nodes must have been updated for this frame.
+ *
+ * @param scene The scene
+ * @param nodes Nodes whose curve is drawn this frame (reordered in place)
+ * @param viewMatrix Model-view matrix of top-level nodes
+ * @return Number of draw calls issued
+ */
+int drawTrajectories(Scene& scene, std::vector<unsigned>& nodes, const float* viewMatrix);
+
+#endif // TRAJECTORIES_H
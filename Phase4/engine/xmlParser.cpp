@@ -8,13 +8,16 @@
 
 #include "tinyxml2.h"
 #include "engine.h"
+#include "scene.h"
 #include <iostream>
 
 using namespace tinyxml2;
 
 
 // Add this new function to parse a group and its transformations
-void parseGroup(XMLElement* groupElement, Group& group, const std::string& xmlDir) {
+void parseGroup(XMLElement* groupElement, Scene& scene, int parent, const std::string& xmlDir) {
+    int node = addSceneNode(scene, parent);
+
     // Parse transform elements
     XMLElement* transformElement = groupElement->FirstChildElement("transform");
     if (transformElement) {
@@ -24,51 +27,50 @@ void parseGroup(XMLElement* groupElement, Group& group, const std::string& xmlDi
             
             if (elemName == "translate") {
                 if (elem->Attribute("time")) {
-                    group.transform.hasCurve = true;
-                    group.transform.curveTime = elem->FloatAttribute("time");
-                    group.transform.align = elem->BoolAttribute("align", false);
+                    CatmullRomCurve curve;
+                    curve.time = elem->FloatAttribute("time");
+                    curve.align = elem->BoolAttribute("align", false);
                     // Lê o atributo draw (por defeito true)
                     const char* drawAttr = elem->Attribute("draw");
-                    group.transform.drawCurve = true;
+                    curve.draw = true;
                     if (drawAttr && std::string(drawAttr) == "false")
-                        group.transform.drawCurve = false;
+                        curve.draw = false;
                     // Parse points
                     for (XMLElement* pointElem = elem->FirstChildElement("point"); pointElem; pointElem = pointElem->NextSiblingElement("point")) {
                         Point p;
                         p.x = pointElem->FloatAttribute("x");
                         p.y = pointElem->FloatAttribute("y");
                         p.z = pointElem->FloatAttribute("z");
-                        group.transform.curvePoints.push_back(p);
+                        curve.points.push_back(p);
                     }
-                    group.transformOrder.push_back("translate_curve");
+                    addSceneCurve(scene, curve);
                 } else {
-                    group.transform.translateX = elem->FloatAttribute("x", 0.0f);
-                    group.transform.translateY = elem->FloatAttribute("y", 0.0f);
-                    group.transform.translateZ = elem->FloatAttribute("z", 0.0f);
-                    group.transformOrder.push_back("translate");
+                    float params[3] = {elem->FloatAttribute("x", 0.0f),
+                                       elem->FloatAttribute("y", 0.0f),
+                                       elem->FloatAttribute("z", 0.0f)};
+                    addTransformOp(scene, OP_TRANSLATE, params, 3);
                 }
             }
             else if (elemName == "rotate") {
                 if (elem->Attribute("time")) {
-                    group.transform.timeRotation = true;
-                    group.transform.rotationTime = elem->FloatAttribute("time");
-                    group.transform.rotateX = elem->FloatAttribute("x", 0.0f);
-                    group.transform.rotateY = elem->FloatAttribute("y", 0.0f);
-                    group.transform.rotateZ = elem->FloatAttribute("z", 0.0f);
-                    group.transformOrder.push_back("rotate_time");
+                    float params[4] = {elem->FloatAttribute("time"),
+                                       elem->FloatAttribute("x", 0.0f),
+                                       elem->FloatAttribute("y", 0.0f),
+                                       elem->FloatAttribute("z", 0.0f)};
+                    addTransformOp(scene, OP_ROTATE_TIME, params, 4);
                 } else {
-                    group.transform.rotateAngle = elem->FloatAttribute("angle", 0.0f);
-                    group.transform.rotateX = elem->FloatAttribute("x", 0.0f);
-                    group.transform.rotateY = elem->FloatAttribute("y", 0.0f);
-                    group.transform.rotateZ = elem->FloatAttribute("z", 0.0f);
-                    group.transformOrder.push_back("rotate");
+                    float params[4] = {elem->FloatAttribute("angle", 0.0f),
+                                       elem->FloatAttribute("x", 0.0f),
+                                       elem->FloatAttribute("y", 0.0f),
+                                       elem->FloatAttribute("z", 0.0f)};
+                    addTransformOp(scene, OP_ROTATE, params, 4);
                 }
             }
             else if (elemName == "scale") {
-                group.transform.scaleX = elem->FloatAttribute("x", 1.0f);
-                group.transform.scaleY = elem->FloatAttribute("y", 1.0f);
-                group.transform.scaleZ = elem->FloatAttribute("z", 1.0f);
-                group.transformOrder.push_back("scale");
+                float params[3] = {elem->FloatAttribute("x", 1.0f),
+                                   elem->FloatAttribute("y", 1.0f),
+                                   elem->FloatAttribute("z", 1.0f)};
+                addTransformOp(scene, OP_SCALE, params, 3);
             }
         }
     }
@@ -81,6 +83,7 @@ void parseGroup(XMLElement* groupElement, Group& group, const std::string& xmlDi
              modelElement = modelElement->NextSiblingElement("model")) {
             
             Model model;
+            Material material;
             std::string modelFile = modelElement->Attribute("file");
             
             model.filename = "../tests/" + modelFile;
@@ -92,6 +95,22 @@ void parseGroup(XMLElement* groupElement, Group& group, const std::string& xmlDi
                     model.textureFile = "../engine/textures/" + std::string(texFile);
                     std::cout << "Associating texture: " << model.textureFile << " with model: " << model.filename << std::endl;
                 }
+
+                // Optional sampler settings: filter="linear|bilinear|trilinear" anisotropy="N"
+                const char* filter = textureElem->Attribute("filter");
+                if (filter) {
+                    std::string filterName = filter;
+                    if (filterName == "linear") {
+                        model.textureSampling.filter = FILTER_LINEAR;
+                    } else if (filterName == "bilinear") {
+                        model.textureSampling.filter = FILTER_BILINEAR;
+                    } else if (filterName == "trilinear") {
+                        model.textureSampling.filter = FILTER_TRILINEAR;
+                    } else {
+                        std::cerr << "Unknown texture filter '" << filterName << "', using trilinear" << std::endl;
+                    }
+                }
+                textureElem->QueryFloatAttribute("anisotropy", &model.textureSampling.anisotropy);
             }
 
             // Parse material/color information
@@ -106,20 +125,20 @@ void parseGroup(XMLElement* groupElement, Group& group, const std::string& xmlDi
                     diffuseElem->QueryIntAttribute("B", &b);
                     
                     // Convert from 0-255 integer range to 0.0-1.0 float range that OpenGL expects
-                    model.material.diffuse.r = r / 255.0f;
-                    model.material.diffuse.g = g / 255.0f;
-                    model.material.diffuse.b = b / 255.0f;
+                    material.diffuse.r = r / 255.0f;
+                    material.diffuse.g = g / 255.0f;
+                    material.diffuse.b = b / 255.0f;
                     
                     // Debug output
                     std::cout << "Parsed diffuse color: RGB(" << r << "," << g << "," << b << ") -> "
-                              << "(" << model.material.diffuse.r << "," 
-                              << model.material.diffuse.g << "," 
-                              << model.material.diffuse.b << ")" << std::endl;
+                              << "(" << material.diffuse.r << "," 
+                              << material.diffuse.g << "," 
+                              << material.diffuse.b << ")" << std::endl;
                 } else {
                     // Default diffuse to light gray if not specified
-                    model.material.diffuse.r = 0.78f;
-                    model.material.diffuse.g = 0.78f;
-                    model.material.diffuse.b = 0.78f;
+                    material.diffuse.r = 0.78f;
+                    material.diffuse.g = 0.78f;
+                    material.diffuse.b = 0.78f;
                 }
                 
                 // Parse ambient color
@@ -129,14 +148,14 @@ void parseGroup(XMLElement* groupElement, Group& group, const std::string& xmlDi
                     ambientElem->QueryIntAttribute("R", &r);
                     ambientElem->QueryIntAttribute("G", &g);
                     ambientElem->QueryIntAttribute("B", &b);
-                    model.material.ambient.r = r / 255.0f;
-                    model.material.ambient.g = g / 255.0f;
-                    model.material.ambient.b = b / 255.0f;
+                    material.ambient.r = r / 255.0f;
+                    material.ambient.g = g / 255.0f;
+                    material.ambient.b = b / 255.0f;
                 } else {
                     // Default ambient to dark gray if not specified
-                    model.material.ambient.r = 0.2f;
-                    model.material.ambient.g = 0.2f;
-                    model.material.ambient.b = 0.2f;
+                    material.ambient.r = 0.2f;
+                    material.ambient.g = 0.2f;
+                    material.ambient.b = 0.2f;
                 }
                 
                 // Parse specular color
@@ -146,14 +165,14 @@ void parseGroup(XMLElement* groupElement, Group& group, const std::string& xmlDi
                     specularElem->QueryIntAttribute("R", &r);
                     specularElem->QueryIntAttribute("G", &g);
                     specularElem->QueryIntAttribute("B", &b);
-                    model.material.specular.r = r / 255.0f;
-                    model.material.specular.g = g / 255.0f;
-                    model.material.specular.b = b / 255.0f;
+                    material.specular.r = r / 255.0f;
+                    material.specular.g = g / 255.0f;
+                    material.specular.b = b / 255.0f;
                 } else {
                     // Default specular to black if not specified
-                    model.material.specular.r = 0.0f;
-                    model.material.specular.g = 0.0f;
-                    model.material.specular.b = 0.0f;
+                    material.specular.r = 0.0f;
+                    material.specular.g = 0.0f;
+                    material.specular.b = 0.0f;
                 }
                 
                 // Parse emissive color
@@ -163,70 +182,68 @@ void parseGroup(XMLElement* groupElement, Group& group, const std::string& xmlDi
                     emissiveElem->QueryIntAttribute("R", &r);
                     emissiveElem->QueryIntAttribute("G", &g);
                     emissiveElem->QueryIntAttribute("B", &b);
-                    model.material.emissive.r = r / 255.0f;
-                    model.material.emissive.g = g / 255.0f;
-                    model.material.emissive.b = b / 255.0f;
+                    material.emissive.r = r / 255.0f;
+                    material.emissive.g = g / 255.0f;
+                    material.emissive.b = b / 255.0f;
                 } else {
                     // Default emissive to black if not specified
-                    model.material.emissive.r = 0.0f;
-                    model.material.emissive.g = 0.0f;
-                    model.material.emissive.b = 0.0f;
+                    material.emissive.r = 0.0f;
+                    material.emissive.g = 0.0f;
+                    material.emissive.b = 0.0f;
                 }
                 
                 // Parse shininess
                 XMLElement* shininessElem = colorElem->FirstChildElement("shininess");
                 if (shininessElem) {
-                    model.material.shininess = shininessElem->FloatAttribute("value", 0.0f);
+                    material.shininess = shininessElem->FloatAttribute("value", 0.0f);
                 } else {
                     // Default shininess to 0 if not specified
-                    model.material.shininess = 0.0f;
+                    material.shininess = 0.0f;
                 }
                 
                 // Debug output for material properties
                 std::cout << "Model: " << model.filename << " Material properties:" << std::endl;
-                std::cout << "  Diffuse: (" << model.material.diffuse.r << ", " 
-                          << model.material.diffuse.g << ", " << model.material.diffuse.b << ")" << std::endl;
-                std::cout << "  Ambient: (" << model.material.ambient.r << ", " 
-                          << model.material.ambient.g << ", " << model.material.ambient.b << ")" << std::endl;
-                std::cout << "  Specular: (" << model.material.specular.r << ", " 
-                          << model.material.specular.g << ", " << model.material.specular.b << ")" << std::endl;
-                std::cout << "  Shininess: " << model.material.shininess << std::endl;
+                std::cout << "  Diffuse: (" << material.diffuse.r << ", " 
+                          << material.diffuse.g << ", " << material.diffuse.b << ")" << std::endl;
+                std::cout << "  Ambient: (" << material.ambient.r << ", " 
+                          << material.ambient.g << ", " << material.ambient.b << ")" << std::endl;
+                std::cout << "  Specular: (" << material.specular.r << ", " 
+                          << material.specular.g << ", " << material.specular.b << ")" << std::endl;
+                std::cout << "  Shininess: " << material.shininess << std::endl;
             } else {
                 // Set default material properties if color element is not present
-                model.material.diffuse.r = 0.78f;
-                model.material.diffuse.g = 0.78f;
-                model.material.diffuse.b = 0.78f;
+                material.diffuse.r = 0.78f;
+                material.diffuse.g = 0.78f;
+                material.diffuse.b = 0.78f;
                 
-                model.material.ambient.r = 0.2f;
-                model.material.ambient.g = 0.2f;
-                model.material.ambient.b = 0.2f;
+                material.ambient.r = 0.2f;
+                material.ambient.g = 0.2f;
+                material.ambient.b = 0.2f;
                 
-                model.material.specular.r = 0.0f;
-                model.material.specular.g = 0.0f;
-                model.material.specular.b = 0.0f;
+                material.specular.r = 0.0f;
+                material.specular.g = 0.0f;
+                material.specular.b = 0.0f;
                 
-                model.material.emissive.r = 0.0f;
-                model.material.emissive.g = 0.0f;
-                model.material.emissive.b = 0.0f;
+                material.emissive.r = 0.0f;
+                material.emissive.g = 0.0f;
+                material.emissive.b = 0.0f;
                 
-                model.material.shininess = 0.0f;
+                material.shininess = 0.0f;
             }
             
             std::cout << "Loading model from: " << model.filename << std::endl;
             
-            group.models.push_back(model);
+            addSceneModel(scene, model, material);
         }
     }
     
-    // Parse child groups recursively
+    // Parse child groups recursively; they are appended right after this node's subtree so far
     for (XMLElement* childGroupElement = groupElement->FirstChildElement("group");
          childGroupElement;
          childGroupElement = childGroupElement->NextSiblingElement("group")) {
-        
-        Group childGroup;
-        parseGroup(childGroupElement, childGroup, xmlDir);
-        group.childGroups.push_back(childGroup);
+        parseGroup(childGroupElement, scene, node, xmlDir);
     }
+    closeSceneNode(scene, node);
 }
 
 
@@ -412,7 +429,7 @@ World parseXMLFile(const char* filename) {
     // Parse the root group
     XMLElement* rootGroupElement = rootElement->FirstChildElement("group");
     if (rootGroupElement) {
-        parseGroup(rootGroupElement, world.rootGroup, xmlDir);
+        parseGroup(rootGroupElement, world.scene, -1, xmlDir);
     }
     
     return world;
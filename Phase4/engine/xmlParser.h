@@ -15,12 +15,15 @@
 World parseXMLFile(const char* filename);
 
 /**
- * @brief Parses a group element from the XML file
+ * @brief Parses a group element (and its subtree) from the XML file
+ * 
+ * The group is appended to the flattened scene in depth-first order.
  * 
  * @param groupElement XML element representing a group
- * @param group Group object to populate
+ * @param scene Scene to append to
+ * @param parent Index of the parent node (-1 for the root group)
  * @param xmlDir Directory containing the XML file (for relative paths)
  */
-void parseGroup(tinyxml2::XMLElement* groupElement, Group& group, const std::string& xmlDir);
+void parseGroup(tinyxml2::XMLElement* groupElement, Scene& scene, int parent, const std::string& xmlDir);
 
 #endif // XML_PARSER_H
\ No newline at end of file
@@ -1,8 +1,68 @@
+#include <algorithm>
+#include <cstdlib>
+#include <functional>
 #include <iostream>
 #include <string>
 #include <unordered_map>
 #include <stdexcept>
+#include <vector>
 #include "generatorAux.h"
+#include "meshFormat.h"
+#include "meshOptimizer.h"
+
+
+/**
+ * @brief Chooses the extension of the standardized output filename
+ *
+ * The output filename argument is otherwise ignored, but when it ends in
+ * ".3db" the model is written in the binary mesh format instead of text.
+ * Indexed, quantized and LOD chain output only exist in the binary format,
+ * so --indexed, --quantize, --lod (and the options that imply them) select ".3db".
+ *
+ * @param requested The output filename given on the command line
+ * @return ".3db" for binary output, ".3d" otherwise
+ */
+std::string outputExtension(const std::string& requested) {
+    const std::string binary = ".3db";
+    const MeshOutputOptions& outputOptions = getMeshOutputOptions();
+    if (outputOptions.indexed || outputOptions.quantize || outputOptions.lodLevels > 1) {
+        return binary;
+    }
+    if (endsWith(requested, binary)) {
+        return binary;
+    }
+    return ".3d";
+}
+
+/**
+ * @brief Generates a primitive once per level of detail, finest first
+ *
+ * Every level halves each detail parameter (slices, stacks, tessellation)
+ * of the one before, but not below its minimum, so the triangle count
+ * drops about 4x per level. The chain ends early once no parameter can be
+ * halved any more. Without --lod only level 0 is generated.
+ *
+ * @param detail Detail parameters of level 0
+ * @param minimum Smallest usable value of each parameter
+ * @param generate Writes one level given its detail parameters
+ */
+void generateLevels(std::vector<int> detail, const std::vector<int>& minimum,
+                    const std::function<void(const std::vector<int>&)>& generate) {
+    for (int level = 0; level < getMeshOutputOptions().lodLevels; level++) {
+        if (level > 0) {
+            bool reduced = false;
+            for (size_t k = 0; k < detail.size(); k++) {
+                int halved = std::max(detail[k] / 2, minimum[k]);
+                reduced = reduced || halved < detail[k];
+                detail[k] = halved;
+            }
+            if (!reduced) break;
+        }
+        setMeshOutputLevel(level);
+        generate(detail);
+    }
+    setMeshOutputLevel(0);
+}
 
 
 
@@ -16,7 +76,7 @@
  * @param argv The array of command line arguments
  *        argv[2]: unit - The half-length of the plane sides
  *        argv[3]: slices - The number of divisions along each axis
- *        argv[4]: output filename (ignored; standardized name is used)
+ *        argv[4]: output filename (only its .3d/.3db extension is used)
  * @throws std::invalid_argument If the required parameters are missing or invalid
  */
 void handlePlane(int argc, char** argv) {
@@ -26,8 +86,8 @@ void handlePlane(int argc, char** argv) {
     float unit = std::stof(argv[2]);
     int slices = std::stoi(argv[3]);
     // Create standardized filename
-    std::string filename = "../tests/plane_" + std::string(argv[2]) + "_" + argv[3] + ".3d";
-    plane(unit, slices, filename);
+    std::string filename = "../tests/plane_" + std::string(argv[2]) + "_" + argv[3] + outputExtension(argv[4]);
+    generateLevels({slices}, {1}, [&](const std::vector<int>& d) { plane(unit, d[0], filename); });
     std::cout << "Plane generated successfully! Saved to " << filename << "\n";
 }
 
@@ -41,7 +101,7 @@ void handlePlane(int argc, char** argv) {
  * @param argv The array of command line arguments
  *        argv[2]: unit - The half-length of the box sides
  *        argv[3]: slices - The number of divisions along each axis of each face
- *        argv[4]: output filename (ignored; standardized name is used)
+ *        argv[4]: output filename (only its .3d/.3db extension is used)
  * @throws std::invalid_argument If the required parameters are missing or invalid
  */
 void handleBox(int argc, char** argv) {
@@ -51,8 +111,8 @@ void handleBox(int argc, char** argv) {
     float unit = std::stof(argv[2]);
     int slices = std::stoi(argv[3]);
     // Create standardized filename
-    std::string filename = "../tests/box_" + std::string(argv[2]) + "_" + argv[3] + ".3d";
-    box(unit, slices, filename);
+    std::string filename = "../tests/box_" + std::string(argv[2]) + "_" + argv[3] + outputExtension(argv[4]);
+    generateLevels({slices}, {1}, [&](const std::vector<int>& d) { box(unit, d[0], filename); });
     std::cout << "Box generated successfully! Saved to " << filename << "\n";
 }
 
@@ -68,7 +128,7 @@ void handleBox(int argc, char** argv) {
  *        argv[3]: height - The height of the cone
  *        argv[4]: slices - The number of divisions around the circular base
  *        argv[5]: stacks - The number of divisions along the height
- *        argv[6]: output filename (ignored; standardized name is used)
+ *        argv[6]: output filename (only its .3d/.3db extension is used)
  * @throws std::invalid_argument If the required parameters are missing or invalid
  */
 void handleCone(int argc, char** argv) {
@@ -83,9 +143,11 @@ void handleCone(int argc, char** argv) {
     
     // Create standardized filename with correct path
     std::string filename = "../tests/cone_" + std::string(argv[2]) + "_" + argv[3] + "_" + 
-                          argv[4] + "_" + argv[5] + ".3d";  // Added "../" prefix
+                          argv[4] + "_" + argv[5] + outputExtension(argv[6]);  // Added "../" prefix
     
-    cone(radius, height, slices, stacks, filename);
+    generateLevels({slices, stacks}, {3, 1}, [&](const std::vector<int>& d) {
+        cone(radius, height, d[0], d[1], filename);
+    });
     std::cout << "Cone generated successfully! Saved to " << filename << "\n";
 }
 
@@ -100,7 +162,7 @@ void handleCone(int argc, char** argv) {
  *        argv[2]: radius - The radius of the sphere
  *        argv[3]: slices - The number of divisions along the longitude (around vertical axis)
  *        argv[4]: stacks - The number of divisions along the latitude (from pole to pole)
- *        argv[5]: output filename (ignored; standardized name is used) 
+ *        argv[5]: output filename (only its .3d/.3db extension is used) 
  * @throws std::invalid_argument If the required parameters are missing or invalid
  */
 void handleSphere(int argc, char** argv) {
@@ -111,8 +173,10 @@ void handleSphere(int argc, char** argv) {
     int slices = std::stoi(argv[3]);
     int stacks = std::stoi(argv[4]);
     // Create standardized filename
-    std::string filename = "../tests/sphere_" + std::string(argv[2]) + "_" + argv[3] + "_" + argv[4] + ".3d";
-    sphere(radius, slices, stacks, filename);
+    std::string filename = "../tests/sphere_" + std::string(argv[2]) + "_" + argv[3] + "_" + argv[4] + outputExtension(argv[5]);
+    generateLevels({slices, stacks}, {3, 2}, [&](const std::vector<int>& d) {
+        sphere(radius, d[0], d[1], filename);
+    });
     std::cout << "Sphere generated successfully! Saved to " << filename << "\n";
 }
 
@@ -128,7 +192,7 @@ void handleSphere(int argc, char** argv) {
  *        argv[3]: innerRadius - The inner radius of the torus
  *        argv[4]: sides - The number of sides of the cross-section
  *        argv[5]: rings - The number of rings around the torus
- *        argv[6]: output filename (ignored; standardized name is used)
+ *        argv[6]: output filename (only its .3d/.3db extension is used)
  * @throws std::invalid_argument If the required parameters are missing or invalid
  */
 void handleTorus(int argc, char** argv) {
@@ -142,9 +206,11 @@ void handleTorus(int argc, char** argv) {
     int rings = std::stoi(argv[5]);
     
     std::string filename = "../tests/torus_" + std::string(argv[2]) + "_" + argv[3] + "_" + 
-                          argv[4] + "_" + argv[5] + ".3d";
+                          argv[4] + "_" + argv[5] + outputExtension(argv[6]);
     
-    torus(outerRadius, innerRadius, sides, rings, filename);
+    generateLevels({sides, rings}, {3, 3}, [&](const std::vector<int>& d) {
+        torus(outerRadius, innerRadius, d[0], d[1], filename);
+    });
     std::cout << "Torus generated successfully! Saved to " << filename << "\n";
 }
 
@@ -157,7 +223,7 @@ void handleTorus(int argc, char** argv) {
  * @param argv The array of command line arguments
  *        argv[2]: patch_file - The file containing the Bezier patch definition
  *        argv[3]: tessellation - The tessellation level
- *        argv[4]: output filename (ignored; standardized name is used)
+ *        argv[4]: output filename (only its .3d/.3db extension is used)
  * @throws std::invalid_argument If the required parameters are missing or invalid
  */
 void handleBezier(int argc, char** argv) {
@@ -169,28 +235,102 @@ void handleBezier(int argc, char** argv) {
     int tessellation = std::stoi(argv[3]);
     
     // Create standardized filename
-    std::string outputFile = "../tests/bezier_" + std::string(argv[3]) + ".3d";
+    std::string outputFile = "../tests/bezier_" + std::string(argv[3]) + outputExtension(argv[4]);
     
-    bezier(patchFile, tessellation, outputFile);
+    generateLevels({tessellation}, {1}, [&](const std::vector<int>& d) { bezier(patchFile, d[0], outputFile); });
     std::cout << "Bezier patch generated successfully! Saved to " << outputFile << "\n";
 }
 
 
 
+/**
+ * @brief Handles the optimization of an existing model file
+ * 
+ * Reads a .3d or .3db file, reorders it for the vertex cache (and for
+ * overdraw with --overdraw) and writes it as an indexed .3db file,
+ * printing the ACMR/ATVR before and after.
+ * 
+ * @param argc The total number of command line arguments
+ * @param argv The array of command line arguments
+ *        argv[2]: input file (.3d or .3db)
+ *        argv[3]: output file (must end in .3db)
+ * @throws std::invalid_argument If the required parameters are missing or invalid
+ */
+void handleMeshopt(int argc, char** argv) {
+    if (argc != 4) {
+        throw std::invalid_argument("Error: Meshopt requires 2 arguments: <input_file> <output_file.3db>");
+    }
+    std::string outputFile = argv[3];
+    if (!endsWith(outputFile, ".3db")) {
+        throw std::invalid_argument("Error: Meshopt writes indexed meshes, the output file must end in .3db");
+    }
+    if (getMeshOutputOptions().lodLevels > 1) {
+        throw std::invalid_argument("Error: Meshopt optimizes an existing mesh, it cannot write --lod levels");
+    }
+
+    IndexedMesh mesh = readIndexedMesh(argv[2]);
+    optimizeMesh(mesh, getMeshOutputOptions().overdraw);
+    writeVerticesBinary(outputFile, mesh.vertices, mesh.indices);
+    std::cout << "Mesh optimized successfully! Saved to " << outputFile << "\n";
+}
+
+
+
 /**
  * @brief Main function - program entry point
  * 
  * Parses command-line arguments and dispatches to the appropriate shape handler function.
  * Uses a map to associate primitive names with their handler functions for extensibility.
  * 
+ * Options may appear anywhere and are removed before the arguments are
+ * handed to the shape handler:
+ *   --indexed   deduplicate vertices and write an indexed .3db file
+ *   --optimize  also reorder the mesh for the vertex cache (implies --indexed)
+ *   --overdraw  also sort triangle clusters to reduce overdraw (implies --optimize)
+ *   --quantize  write 16-byte quantized vertices (binary .3db only)
+ *   --lod N     write a chain of N levels of detail (binary .3db only)
+ * 
  * @param argc The total number of command line arguments
  * @param argv The array of command line arguments
  *        argv[0]: program name
- *        argv[1]: shape type (plane, box, cone, sphere, torus, circle)
+ *        argv[1]: shape type (plane, box, cone, sphere, torus, bezier) or meshopt
  *        argv[2+]: shape-specific parameters
  * @return 0 on successful execution, 1 on error
  */
 int main(int argc, char** argv) {
+    // Separate the options from the positional arguments
+    MeshOutputOptions outputOptions;
+    std::vector<char*> args;
+    for (int i = 0; i < argc; i++) {
+        std::string arg = argv[i];
+        if (i > 0 && arg.compare(0, 2, "--") == 0) {
+            if (arg == "--indexed") {
+                outputOptions.indexed = true;
+            } else if (arg == "--optimize") {
+                outputOptions.indexed = outputOptions.optimize = true;
+            } else if (arg == "--overdraw") {
+                outputOptions.indexed = outputOptions.optimize = outputOptions.overdraw = true;
+            } else if (arg == "--quantize") {
+                outputOptions.quantize = true;
+            } else if (arg == "--lod") {
+                int levels = i + 1 < argc ? std::atoi(argv[++i]) : 0;
+                if (levels < 1 || levels > static_cast<int>(MESH_MAX_LOD_LEVELS)) {
+                    std::cerr << "Error: --lod needs a level count from 1 to " << MESH_MAX_LOD_LEVELS << ".\n";
+                    return 1;
+                }
+                outputOptions.lodLevels = levels;
+            } else {
+                std::cerr << "Error: Unknown option '" << arg << "'.\n";
+                return 1;
+            }
+        } else {
+            args.push_back(argv[i]);
+        }
+    }
+    setMeshOutputOptions(outputOptions);
+    argc = static_cast<int>(args.size());
+    argv = args.data();
+
     std::unordered_map<std::string, void (*)(int, char**)> shapeHandlers;
     shapeHandlers["plane"] = handlePlane;
     shapeHandlers["box"] = handleBox;
@@ -198,6 +338,7 @@ int main(int argc, char** argv) {
     shapeHandlers["sphere"] = handleSphere;
     shapeHandlers["torus"] = handleTorus;
     shapeHandlers["bezier"] = handleBezier;
+    shapeHandlers["meshopt"] = handleMeshopt;
 
     //Controle de erros
     if (argc < 2) {
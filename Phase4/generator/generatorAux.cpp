@@ -6,7 +6,14 @@
 #include <stdexcept>
 #include <array>
 #include <sstream>
+#include <cstring>
+#include <limits>
+#include <algorithm>
+#include <unordered_map>
+#include <iterator>
 #include "generatorAux.h"
+#include "meshFormat.h"
+#include "meshOptimizer.h"
 
 //-- MATRIX OPERATIONS --
 //Define the 4x4 matrix type
@@ -160,15 +167,277 @@ void writeVertices(const std::string& filename, const std::vector<Vertex>& verti
     file.close();
 }
 
-// Structure for vertex with normal and texture coordinates
-struct VertexFull {
-    float x, y, z;         // Position
-    float nx, ny, nz;      // Normal
-    float u, v;            // Texture coordinates
+// Appends one vertex (position, normal, texture coordinates) to a mesh
+static void addVertex(std::vector<VertexFull>& vertices,
+                      float x, float y, float z,
+                      float nx, float ny, float nz,
+                      float u, float v) {
+    VertexFull vertex = {x, y, z, nx, ny, nz, u, v};
+    vertices.push_back(vertex);
+}
+
+bool endsWith(const std::string& str, const std::string& suffix) {
+    return str.size() >= suffix.size() &&
+           str.compare(str.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+// Options set from the command line
+static MeshOutputOptions outputOptions;
+
+void setMeshOutputOptions(const MeshOutputOptions& options) {
+    outputOptions = options;
+}
+
+const MeshOutputOptions& getMeshOutputOptions() {
+    return outputOptions;
+}
+
+// Level of detail of the next mesh written (0 creates the file)
+static int outputLevel = 0;
+
+void setMeshOutputLevel(int level) {
+    outputLevel = level;
+}
+
+namespace {
+
+// Bit pattern of a float, with -0.0 folded into 0.0 so both hash the same
+uint32_t floatKey(float f) {
+    if (f == 0.0f) f = 0.0f;
+    uint32_t bits;
+    std::memcpy(&bits, &f, sizeof(bits));
+    return bits;
+}
+
+// Exact key of a vertex (all 8 attributes)
+struct VertexKey {
+    uint32_t bits[8];
+
+    bool operator==(const VertexKey& other) const {
+        return std::memcmp(bits, other.bits, sizeof(bits)) == 0;
+    }
+};
+
+struct VertexKeyHash {
+    size_t operator()(const VertexKey& key) const {
+        // FNV-1a over the 8 words
+        uint64_t hash = 14695981039346656037ull;
+        for (uint32_t word : key.bits) {
+            hash = (hash ^ word) * 1099511628211ull;
+        }
+        return static_cast<size_t>(hash ^ (hash >> 32));
+    }
 };
 
-// Writes vertices with normals and texture coordinates to a file
+} // namespace
+
+IndexedMesh buildIndexedMesh(const std::vector<VertexFull>& triangles) {
+    IndexedMesh mesh;
+    mesh.indices.reserve(triangles.size());
+
+    std::unordered_map<VertexKey, uint32_t, VertexKeyHash> uniqueVertices;
+    uniqueVertices.reserve(triangles.size());
+    for (const auto& v : triangles) {
+        const float attributes[8] = {v.x, v.y, v.z, v.nx, v.ny, v.nz, v.u, v.v};
+        VertexKey key;
+        for (int k = 0; k < 8; k++) key.bits[k] = floatKey(attributes[k]);
+
+        auto inserted = uniqueVertices.insert(std::make_pair(key, static_cast<uint32_t>(mesh.vertices.size())));
+        if (inserted.second) {
+            mesh.vertices.push_back(v);
+        }
+        mesh.indices.push_back(inserted.first->second);
+    }
+    return mesh;
+}
+
+// Writes a mesh in the binary .3db container with one bulk write per attribute (indices may be empty)
+void writeVerticesBinary(const std::string& filename, const std::vector<VertexFull>& vertices,
+                         const std::vector<uint32_t>& indices) {
+    std::ios::openmode mode = std::ios::binary;
+    if (outputLevel > 0) mode |= std::ios::app;
+    std::ofstream file(filename, mode);
+    if (!file.is_open()) {
+        throw std::runtime_error("Error: Unable to open file " + filename);
+    }
+
+    MeshFileHeader header;
+    std::memcpy(header.magic, MESH_FILE_MAGIC, sizeof(header.magic));
+    header.version = MESH_FILE_VERSION;
+    header.vertexCount = static_cast<uint32_t>(vertices.size());
+    header.attribMask = MESH_ATTRIB_POSITION | MESH_ATTRIB_NORMAL | MESH_ATTRIB_TEXCOORD;
+    if (outputOptions.quantize) header.attribMask |= MESH_ATTRIB_QUANTIZED;
+    header.indexCount = static_cast<uint32_t>(indices.size());
+    for (int k = 0; k < 3; k++) {
+        header.boundsMin[k] = vertices.empty() ? 0.0f : std::numeric_limits<float>::max();
+        header.boundsMax[k] = vertices.empty() ? 0.0f : -std::numeric_limits<float>::max();
+    }
+    for (const auto& v : vertices) {
+        const float p[3] = {v.x, v.y, v.z};
+        for (int k = 0; k < 3; k++) {
+            header.boundsMin[k] = std::min(header.boundsMin[k], p[k]);
+            header.boundsMax[k] = std::max(header.boundsMax[k], p[k]);
+        }
+    }
+
+    std::vector<float> data;
+    std::vector<unsigned char> packed;
+    if (outputOptions.quantize) {
+        // One interleaved block of 16-byte vertices, written little-endian byte by byte
+        MeshPositionQuantization q = meshPositionQuantization(header);
+        packed.resize(vertices.size() * MESH_QUANTIZED_VERTEX_SIZE);
+        for (size_t i = 0; i < vertices.size(); i++) {
+            const VertexFull& v = vertices[i];
+            const float position[3] = {v.x, v.y, v.z};
+            const float normal[3] = {v.nx, v.ny, v.nz};
+            const float texCoord[2] = {v.u, v.v};
+            packQuantizedVertex(q, position, normal, texCoord, &packed[i * MESH_QUANTIZED_VERTEX_SIZE]);
+        }
+    } else {
+        // Split the vertices into one contiguous block per attribute
+        data.reserve(vertices.size() * meshFloatsPerVertex(header.attribMask));
+        for (const auto& v : vertices) {
+            data.push_back(v.x);
+            data.push_back(v.y);
+            data.push_back(v.z);
+        }
+        for (const auto& v : vertices) {
+            data.push_back(v.nx);
+            data.push_back(v.ny);
+            data.push_back(v.nz);
+        }
+        for (const auto& v : vertices) {
+            data.push_back(v.u);
+            data.push_back(v.v);
+        }
+    }
+    std::vector<uint32_t> indexData(indices);
+
+    if (!isLittleEndianHost()) {
+        swapMeshHeader(header);
+        swapWords(data.data(), data.size());
+        swapWords(indexData.data(), indexData.size());
+    }
+
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(data.data()), data.size() * sizeof(float));
+    file.write(reinterpret_cast<const char*>(packed.data()), packed.size());
+    file.write(reinterpret_cast<const char*>(indexData.data()), indexData.size() * sizeof(uint32_t));
+    if (!file) {
+        throw std::runtime_error("Error: Failed writing file " + filename);
+    }
+    file.close();
+}
+
+IndexedMesh readIndexedMesh(const std::string& filename) {
+    std::ifstream file(filename, std::ios::binary);
+    if (!file.is_open()) {
+        throw std::runtime_error("Error: Unable to open file " + filename);
+    }
+    std::vector<char> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+    // Text .3d: one vertex per line (position, normal, texture coordinates)
+    if (!isMeshFileMagic(data.data(), data.size())) {
+        std::istringstream text(std::string(data.begin(), data.end()));
+        std::vector<VertexFull> triangles;
+        VertexFull v;
+        while (text >> v.x >> v.y >> v.z >> v.nx >> v.ny >> v.nz >> v.u >> v.v) {
+            triangles.push_back(v);
+        }
+        return buildIndexedMesh(triangles);
+    }
+
+    MeshFileHeader header;
+    std::memcpy(&header, data.data(), std::min(data.size(), sizeof(header)));
+    if (!isLittleEndianHost()) swapMeshHeader(header);
+    if (data.size() < sizeof(header) || header.version < MESH_FILE_MIN_VERSION ||
+        header.version > MESH_FILE_VERSION || !isValidMeshAttribMask(header.attribMask) ||
+        data.size() < meshFileSize(header)) {
+        throw std::runtime_error("Error: Unsupported or truncated mesh file " + filename);
+    }
+
+    size_t count = header.vertexCount;
+    std::vector<VertexFull> vertices(count, VertexFull{0, 0, 0, 0, 0, 0, 0, 0});
+    bool quantized = (header.attribMask & MESH_ATTRIB_QUANTIZED) != 0;
+    std::vector<float> floats(quantized ? 0 : count * meshFloatsPerVertex(header.attribMask));
+    std::memcpy(floats.data(), data.data() + sizeof(header), floats.size() * sizeof(float));
+    std::vector<uint32_t> indices(header.indexCount);
+    std::memcpy(indices.data(), data.data() + meshIndexOffset(header), indices.size() * sizeof(uint32_t));
+    if (!isLittleEndianHost()) {
+        swapWords(floats.data(), floats.size());
+        swapWords(indices.data(), indices.size());
+    }
+    if (!meshIndicesInRange(indices.data(), indices.size(), header.vertexCount)) {
+        throw std::runtime_error("Error: Index out of range in " + filename);
+    }
+
+    if (quantized) {
+        MeshPositionQuantization q = meshPositionQuantization(header);
+        const unsigned char* packed = reinterpret_cast<const unsigned char*>(data.data() + sizeof(header));
+        for (size_t i = 0; i < count; i++) {
+            float position[3], normal[3], texCoord[2];
+            unpackQuantizedVertex(q, packed + i * MESH_QUANTIZED_VERTEX_SIZE, position, normal, texCoord);
+            vertices[i] = VertexFull{position[0], position[1], position[2],
+                                     normal[0], normal[1], normal[2], texCoord[0], texCoord[1]};
+        }
+    } else {
+        // Gather the attribute blocks back into interleaved vertices
+        const float* positions = floats.data();
+        const float* normals = (header.attribMask & MESH_ATTRIB_NORMAL) ? positions + count * 3 : nullptr;
+        const float* texCoords = (header.attribMask & MESH_ATTRIB_TEXCOORD)
+                                     ? positions + count * (normals ? 6 : 3) : nullptr;
+        for (size_t i = 0; i < count; i++) {
+            VertexFull& v = vertices[i];
+            v.x = positions[i * 3];
+            v.y = positions[i * 3 + 1];
+            v.z = positions[i * 3 + 2];
+            if (normals) {
+                v.nx = normals[i * 3];
+                v.ny = normals[i * 3 + 1];
+                v.nz = normals[i * 3 + 2];
+            }
+            if (texCoords) {
+                v.u = texCoords[i * 2];
+                v.v = texCoords[i * 2 + 1];
+            }
+        }
+    }
+
+    if (indices.empty()) {
+        return buildIndexedMesh(vertices);
+    }
+    IndexedMesh mesh;
+    mesh.vertices.swap(vertices);
+    mesh.indices.swap(indices);
+    return mesh;
+}
+
+// Writes vertices with normals and texture coordinates to a file.
+// Files ending in ".3db" use the binary container (indexed on request), anything else the text format.
 void writeVerticesFull(const std::string& filename, const std::vector<VertexFull>& vertices) {
+    if (endsWith(filename, ".3db")) {
+        if (outputOptions.lodLevels > 1) {
+            std::cout << "Level " << outputLevel << ": " << vertices.size() / 3 << " triangles" << std::endl;
+        }
+        if (outputOptions.indexed) {
+            IndexedMesh mesh = buildIndexedMesh(vertices);
+            std::cout << "Indexed " << vertices.size() << " vertices into " << mesh.vertices.size()
+                      << " unique vertices" << std::endl;
+            if (outputOptions.optimize) {
+                optimizeMesh(mesh, outputOptions.overdraw);
+            }
+            writeVerticesBinary(filename, mesh.vertices, mesh.indices);
+        } else {
+            writeVerticesBinary(filename, vertices, std::vector<uint32_t>());
+        }
+        if (outputOptions.quantize) {
+            std::cout << "Quantized vertices to " << MESH_QUANTIZED_VERTEX_SIZE << " bytes (from "
+                      << meshVertexSize(MESH_ATTRIB_POSITION | MESH_ATTRIB_NORMAL | MESH_ATTRIB_TEXCOORD)
+                      << ")" << std::endl;
+        }
+        return;
+    }
+
     std::ofstream file(filename);
     if (!file.is_open()) {
         throw std::runtime_error("Error: Unable to open file " + filename);
@@ -189,10 +458,7 @@ void plane(float unit, int slices, const std::string& filename) {
         throw std::invalid_argument("Error: Unit and slices must be positive.");
     }
 
-    std::ofstream file(filename);
-    if (!file.is_open()) {
-        throw std::runtime_error("Error: Unable to open file " + filename);
-    }
+    std::vector<VertexFull> vertices;
 
     float comp = unit / slices;
     float offset = unit / 2.0f;
@@ -207,34 +473,34 @@ void plane(float unit, int slices, const std::string& filename) {
             z2 = (j+1) * comp - offset;
 
             // Triangle 1
-            file << x1 << ' ' << 0.0f << ' ' << z1 << ' ';
-            file << 0.0f << ' ' << 1.0f << ' ' << 0.0f << ' ';
-            file << i*text << ' ' << j*text << '\n';
+            addVertex(vertices, x1, 0.0f, z1,
+                      0.0f, 1.0f, 0.0f,
+                      i*text, j*text);
 
-            file << x2 << ' ' << 0.0f << ' ' << z2 << ' ';
-            file << 0.0f << ' ' << 1.0f << ' ' << 0.0f << ' ';
-            file << (i+1)*text << ' ' << (j+1)*text << '\n';
+            addVertex(vertices, x2, 0.0f, z2,
+                      0.0f, 1.0f, 0.0f,
+                      (i+1)*text, (j+1)*text);
 
-            file << x2 << ' ' << 0.0f << ' ' << z1 << ' ';
-            file << 0.0f << ' ' << 1.0f << ' ' << 0.0f << ' ';
-            file << (i+1)*text << ' ' << j*text << '\n';
+            addVertex(vertices, x2, 0.0f, z1,
+                      0.0f, 1.0f, 0.0f,
+                      (i+1)*text, j*text);
 
             // Triangle 2
-            file << x1 << ' ' << 0.0f << ' ' << z1 << ' ';
-            file << 0.0f << ' ' << 1.0f << ' ' << 0.0f << ' ';
-            file << i*text << ' ' << j*text << '\n';
+            addVertex(vertices, x1, 0.0f, z1,
+                      0.0f, 1.0f, 0.0f,
+                      i*text, j*text);
 
-            file << x1 << ' ' << 0.0f << ' ' << z2 << ' ';
-            file << 0.0f << ' ' << 1.0f << ' ' << 0.0f << ' ';
-            file << i*text << ' ' << (j+1)*text << '\n';
+            addVertex(vertices, x1, 0.0f, z2,
+                      0.0f, 1.0f, 0.0f,
+                      i*text, (j+1)*text);
 
-            file << x2 << ' ' << 0.0f << ' ' << z2 << ' ';
-            file << 0.0f << ' ' << 1.0f << ' ' << 0.0f << ' ';
-            file << (i+1)*text << ' ' << (j+1)*text << '\n';
+            addVertex(vertices, x2, 0.0f, z2,
+                      0.0f, 1.0f, 0.0f,
+                      (i+1)*text, (j+1)*text);
         }
     }
     
-    file.close();
+    writeVerticesFull(filename, vertices);
 }
 
 // Generates points for a box with normals and texture coordinates
@@ -243,10 +509,7 @@ void box(float unit, int slices, const std::string& filename) {
         throw std::invalid_argument("Error: Unit and slices must be positive.");
     }
 
-    std::ofstream file(filename);
-    if (!file.is_open()) {
-        throw std::runtime_error("Error: Unable to open file " + filename);
-    }
+    std::vector<VertexFull> vertices;
 
     float comp = unit / slices;
     float offset = unit / 2.0f;
@@ -266,54 +529,54 @@ void box(float unit, int slices, const std::string& filename) {
             tz2 = (j+1)*text;
 
             // Top (+Y)
-            file << x1 << ' ' << offset << ' ' << z1 << ' ';
-            file << 0.0f << ' ' << 1.0f << ' ' << 0.0f << ' ';
-            file << tx1 << ' ' << tz1 << '\n';
+            addVertex(vertices, x1, offset, z1,
+                      0.0f, 1.0f, 0.0f,
+                      tx1, tz1);
 
-            file << x2 << ' ' << offset << ' ' << z2 << ' ';
-            file << 0.0f << ' ' << 1.0f << ' ' << 0.0f << ' ';
-            file << tx2 << ' ' << tz2 << '\n';
+            addVertex(vertices, x2, offset, z2,
+                      0.0f, 1.0f, 0.0f,
+                      tx2, tz2);
 
-            file << x2 << ' ' << offset << ' ' << z1 << ' ';
-            file << 0.0f << ' ' << 1.0f << ' ' << 0.0f << ' ';
-            file << tx2 << ' ' << tz1 << '\n';
+            addVertex(vertices, x2, offset, z1,
+                      0.0f, 1.0f, 0.0f,
+                      tx2, tz1);
 
-            file << x1 << ' ' << offset << ' ' << z1 << ' ';
-            file << 0.0f << ' ' << 1.0f << ' ' << 0.0f << ' ';
-            file << tx1 << ' ' << tz1 << '\n';
+            addVertex(vertices, x1, offset, z1,
+                      0.0f, 1.0f, 0.0f,
+                      tx1, tz1);
 
-            file << x1 << ' ' << offset << ' ' << z2 << ' ';
-            file << 0.0f << ' ' << 1.0f << ' ' << 0.0f << ' ';
-            file << tx1 << ' ' << tz2 << '\n';
+            addVertex(vertices, x1, offset, z2,
+                      0.0f, 1.0f, 0.0f,
+                      tx1, tz2);
 
-            file << x2 << ' ' << offset << ' ' << z2 << ' ';
-            file << 0.0f << ' ' << 1.0f << ' ' << 0.0f << ' ';
-            file << tx2 << ' ' << tz2 << '\n';
+            addVertex(vertices, x2, offset, z2,
+                      0.0f, 1.0f, 0.0f,
+                      tx2, tz2);
 
             // Bottom (-Y)
-            file << x2 << ' ' << -offset << ' ' << z2 << ' ';
-            file << 0.0f << ' ' << -1.0f << ' ' << 0.0f << ' ';
-            file << tx2 << ' ' << tz2 << '\n';
+            addVertex(vertices, x2, -offset, z2,
+                      0.0f, -1.0f, 0.0f,
+                      tx2, tz2);
 
-            file << x1 << ' ' << -offset << ' ' << z1 << ' ';
-            file << 0.0f << ' ' << -1.0f << ' ' << 0.0f << ' ';
-            file << tx1 << ' ' << tz1 << '\n';
+            addVertex(vertices, x1, -offset, z1,
+                      0.0f, -1.0f, 0.0f,
+                      tx1, tz1);
 
-            file << x2 << ' ' << -offset << ' ' << z1 << ' ';
-            file << 0.0f << ' ' << -1.0f << ' ' << 0.0f << ' ';
-            file << tx2 << ' ' << tz1 << '\n';
+            addVertex(vertices, x2, -offset, z1,
+                      0.0f, -1.0f, 0.0f,
+                      tx2, tz1);
 
-            file << x1 << ' ' << -offset << ' ' << z2 << ' ';
-            file << 0.0f << ' ' << -1.0f << ' ' << 0.0f << ' ';
-            file << tx1 << ' ' << tz2 << '\n';
+            addVertex(vertices, x1, -offset, z2,
+                      0.0f, -1.0f, 0.0f,
+                      tx1, tz2);
 
-            file << x1 << ' ' << -offset << ' ' << z1 << ' ';
-            file << 0.0f << ' ' << -1.0f << ' ' << 0.0f << ' ';
-            file << tx1 << ' ' << tz1 << '\n';
+            addVertex(vertices, x1, -offset, z1,
+                      0.0f, -1.0f, 0.0f,
+                      tx1, tz1);
 
-            file << x2 << ' ' << -offset << ' ' << z2 << ' ';
-            file << 0.0f << ' ' << -1.0f << ' ' << 0.0f << ' ';
-            file << tx2 << ' ' << tz2 << '\n';
+            addVertex(vertices, x2, -offset, z2,
+                      0.0f, -1.0f, 0.0f,
+                      tx2, tz2);
         }
     }
 
@@ -330,54 +593,54 @@ void box(float unit, int slices, const std::string& filename) {
             tz2 = (j+1)*text;
 
             // Front (+Z)
-            file << x2 << ' ' << y2 << ' ' << offset << ' ';
-            file << 0.0f << ' ' << 0.0f << ' ' << 1.0f << ' ';
-            file << tx2 << ' ' << tz2 << '\n';
+            addVertex(vertices, x2, y2, offset,
+                      0.0f, 0.0f, 1.0f,
+                      tx2, tz2);
 
-            file << x1 << ' ' << y1 << ' ' << offset << ' ';
-            file << 0.0f << ' ' << 0.0f << ' ' << 1.0f << ' ';
-            file << tx1 << ' ' << tz1 << '\n';
+            addVertex(vertices, x1, y1, offset,
+                      0.0f, 0.0f, 1.0f,
+                      tx1, tz1);
 
-            file << x2 << ' ' << y1 << ' ' << offset << ' ';
-            file << 0.0f << ' ' << 0.0f << ' ' << 1.0f << ' ';
-            file << tx2 << ' ' << tz1 << '\n';
+            addVertex(vertices, x2, y1, offset,
+                      0.0f, 0.0f, 1.0f,
+                      tx2, tz1);
 
-            file << x1 << ' ' << y2 << ' ' << offset << ' ';
-            file << 0.0f << ' ' << 0.0f << ' ' << 1.0f << ' ';
-            file << tx1 << ' ' << tz2 << '\n';
+            addVertex(vertices, x1, y2, offset,
+                      0.0f, 0.0f, 1.0f,
+                      tx1, tz2);
 
-            file << x1 << ' ' << y1 << ' ' << offset << ' ';
-            file << 0.0f << ' ' << 0.0f << ' ' << 1.0f << ' ';
-            file << tx1 << ' ' << tz1 << '\n';
+            addVertex(vertices, x1, y1, offset,
+                      0.0f, 0.0f, 1.0f,
+                      tx1, tz1);
 
-            file << x2 << ' ' << y2 << ' ' << offset << ' ';
-            file << 0.0f << ' ' << 0.0f << ' ' << 1.0f << ' ';
-            file << tx2 << ' ' << tz2 << '\n';
+            addVertex(vertices, x2, y2, offset,
+                      0.0f, 0.0f, 1.0f,
+                      tx2, tz2);
 
             // Back (-Z)
-            file << x1 << ' ' << y1 << ' ' << -offset << ' ';
-            file << 0.0f << ' ' << 0.0f << ' ' << -1.0f << ' ';
-            file << tx1 << ' ' << tz1 << '\n';
+            addVertex(vertices, x1, y1, -offset,
+                      0.0f, 0.0f, -1.0f,
+                      tx1, tz1);
 
-            file << x2 << ' ' << y2 << ' ' << -offset << ' ';
-            file << 0.0f << ' ' << 0.0f << ' ' << -1.0f << ' ';
-            file << tx2 << ' ' << tz2 << '\n';
+            addVertex(vertices, x2, y2, -offset,
+                      0.0f, 0.0f, -1.0f,
+                      tx2, tz2);
 
-            file << x2 << ' ' << y1 << ' ' << -offset << ' ';
-            file << 0.0f << ' ' << 0.0f << ' ' << -1.0f << ' ';
-            file << tx2 << ' ' << tz1 << '\n';
+            addVertex(vertices, x2, y1, -offset,
+                      0.0f, 0.0f, -1.0f,
+                      tx2, tz1);
 
-            file << x1 << ' ' << y1 << ' ' << -offset << ' ';
-            file << 0.0f << ' ' << 0.0f << ' ' << -1.0f << ' ';
-            file << tx1 << ' ' << tz1 << '\n';
+            addVertex(vertices, x1, y1, -offset,
+                      0.0f, 0.0f, -1.0f,
+                      tx1, tz1);
 
-            file << x1 << ' ' << y2 << ' ' << -offset << ' ';
-            file << 0.0f << ' ' << 0.0f << ' ' << -1.0f << ' ';
-            file << tx1 << ' ' << tz2 << '\n';
+            addVertex(vertices, x1, y2, -offset,
+                      0.0f, 0.0f, -1.0f,
+                      tx1, tz2);
 
-            file << x2 << ' ' << y2 << ' ' << -offset << ' ';
-            file << 0.0f << ' ' << 0.0f << ' ' << -1.0f << ' ';
-            file << tx2 << ' ' << tz2 << '\n';
+            addVertex(vertices, x2, y2, -offset,
+                      0.0f, 0.0f, -1.0f,
+                      tx2, tz2);
         }
     }
 
@@ -394,58 +657,58 @@ void box(float unit, int slices, const std::string& filename) {
             tz2 = (j+1)*text;
 
             // Right (+X)
-            file << offset << ' ' << y1 << ' ' << z1 << ' ';
-            file << 1.0f << ' ' << 0.0f << ' ' << 0.0f << ' ';
-            file << tx1 << ' ' << tz1 << '\n';
+            addVertex(vertices, offset, y1, z1,
+                      1.0f, 0.0f, 0.0f,
+                      tx1, tz1);
 
-            file << offset << ' ' << y2 << ' ' << z2 << ' ';
-            file << 1.0f << ' ' << 0.0f << ' ' << 0.0f << ' ';
-            file << tx2 << ' ' << tz2 << '\n';
+            addVertex(vertices, offset, y2, z2,
+                      1.0f, 0.0f, 0.0f,
+                      tx2, tz2);
 
-            file << offset << ' ' << y1 << ' ' << z2 << ' ';
-            file << 1.0f << ' ' << 0.0f << ' ' << 0.0f << ' ';
-            file << tx2 << ' ' << tz1 << '\n';
+            addVertex(vertices, offset, y1, z2,
+                      1.0f, 0.0f, 0.0f,
+                      tx2, tz1);
 
-            file << offset << ' ' << y1 << ' ' << z1 << ' ';
-            file << 1.0f << ' ' << 0.0f << ' ' << 0.0f << ' ';
-            file << tx1 << ' ' << tz1 << '\n';
+            addVertex(vertices, offset, y1, z1,
+                      1.0f, 0.0f, 0.0f,
+                      tx1, tz1);
 
-            file << offset << ' ' << y2 << ' ' << z1 << ' ';
-            file << 1.0f << ' ' << 0.0f << ' ' << 0.0f << ' ';
-            file << tx1 << ' ' << tz2 << '\n';
+            addVertex(vertices, offset, y2, z1,
+                      1.0f, 0.0f, 0.0f,
+                      tx1, tz2);
 
-            file << offset << ' ' << y2 << ' ' << z2 << ' ';
-            file << 1.0f << ' ' << 0.0f << ' ' << 0.0f << ' ';
-            file << tx2 << ' ' << tz2 << '\n';
+            addVertex(vertices, offset, y2, z2,
+                      1.0f, 0.0f, 0.0f,
+                      tx2, tz2);
 
             // Left (-X)
-            file << -offset << ' ' << y2 << ' ' << z2 << ' ';
-            file << -1.0f << ' ' << 0.0f << ' ' << 0.0f << ' ';
-            file << tx2 << ' ' << tz2 << '\n';
+            addVertex(vertices, -offset, y2, z2,
+                      -1.0f, 0.0f, 0.0f,
+                      tx2, tz2);
 
-            file << -offset << ' ' << y1 << ' ' << z1 << ' ';
-            file << -1.0f << ' ' << 0.0f << ' ' << 0.0f << ' ';
-            file << tx1 << ' ' << tz1 << '\n';
+            addVertex(vertices, -offset, y1, z1,
+                      -1.0f, 0.0f, 0.0f,
+                      tx1, tz1);
 
-            file << -offset << ' ' << y1 << ' ' << z2 << ' ';
-            file << -1.0f << ' ' << 0.0f << ' ' << 0.0f << ' ';
-            file << tx2 << ' ' << tz1 << '\n';
+            addVertex(vertices, -offset, y1, z2,
+                      -1.0f, 0.0f, 0.0f,
+                      tx2, tz1);
 
-            file << -offset << ' ' << y2 << ' ' << z1 << ' ';
-            file << -1.0f << ' ' << 0.0f << ' ' << 0.0f << ' ';
-            file << tx1 << ' ' << tz2 << '\n';
+            addVertex(vertices, -offset, y2, z1,
+                      -1.0f, 0.0f, 0.0f,
+                      tx1, tz2);
 
-            file << -offset << ' ' << y1 << ' ' << z1 << ' ';
-            file << -1.0f << ' ' << 0.0f << ' ' << 0.0f << ' ';
-            file << tx1 << ' ' << tz1 << '\n';
+            addVertex(vertices, -offset, y1, z1,
+                      -1.0f, 0.0f, 0.0f,
+                      tx1, tz1);
 
-            file << -offset << ' ' << y2 << ' ' << z2 << ' ';
-            file << -1.0f << ' ' << 0.0f << ' ' << 0.0f << ' ';
-            file << tx2 << ' ' << tz2 << '\n';
+            addVertex(vertices, -offset, y2, z2,
+                      -1.0f, 0.0f, 0.0f,
+                      tx2, tz2);
         }
     }
 
-    file.close();
+    writeVerticesFull(filename, vertices);
 }
 
 // Generates points for a sphere with normals and texture coordinates
@@ -454,10 +717,7 @@ void sphere(float radius, int slices, int stacks, const std::string& filename) {
         throw std::invalid_argument("Error: Radius, slices, and stacks must be positive.");
     }
 
-    std::ofstream file(filename);
-    if (!file.is_open()) {
-        throw std::runtime_error("Error: Unable to open file " + filename);
-    }
+    std::vector<VertexFull> vertices;
 
     float arch_alfa = 2 * M_PI / slices;
     float arch_beta = M_PI / stacks;
@@ -508,35 +768,35 @@ void sphere(float radius, int slices, int stacks, const std::string& filename) {
             normalize(p4n);
 
             if (j != stacks-1) {
-                file << x1 << ' ' << y1 << ' ' << z1 << ' ';
-                file << p1n[0] << ' ' << p1n[1] << ' ' << p1n[2] << ' ';
-                file << (float)i/slices << ' ' << 1.0f - (float)j/stacks << '\n';
+                addVertex(vertices, x1, y1, z1,
+                          p1n[0], p1n[1], p1n[2],
+                          (float)i/slices, 1.0f - (float)j/stacks);
                 
-                file << x2 << ' ' << y2 << ' ' << z2 << ' ';
-                file << p2n[0] << ' ' << p2n[1] << ' ' << p2n[2] << ' ';
-                file << (float)i/slices << ' ' << 1.0f - (float)(j+1)/stacks << '\n';
+                addVertex(vertices, x2, y2, z2,
+                          p2n[0], p2n[1], p2n[2],
+                          (float)i/slices, 1.0f - (float)(j+1)/stacks);
                 
-                file << x3 << ' ' << y3 << ' ' << z3 << ' ';
-                file << p3n[0] << ' ' << p3n[1] << ' ' << p3n[2] << ' ';
-                file << (float)(i+1)/slices << ' ' << 1.0f - (float)(j+1)/stacks << '\n';
+                addVertex(vertices, x3, y3, z3,
+                          p3n[0], p3n[1], p3n[2],
+                          (float)(i+1)/slices, 1.0f - (float)(j+1)/stacks);
             }
             if (j != 0) {
-                file << x1 << ' ' << y1 << ' ' << z1 << ' ';
-                file << p1n[0] << ' ' << p1n[1] << ' ' << p1n[2] << ' ';
-                file << (float)i/slices << ' ' << 1.0f - (float)j/stacks << '\n';
+                addVertex(vertices, x1, y1, z1,
+                          p1n[0], p1n[1], p1n[2],
+                          (float)i/slices, 1.0f - (float)j/stacks);
                 
-                file << x3 << ' ' << y3 << ' ' << z3 << ' ';
-                file << p3n[0] << ' ' << p3n[1] << ' ' << p3n[2] << ' ';
-                file << (float)(i+1)/slices << ' ' << 1.0f - (float)(j+1)/stacks << '\n';
+                addVertex(vertices, x3, y3, z3,
+                          p3n[0], p3n[1], p3n[2],
+                          (float)(i+1)/slices, 1.0f - (float)(j+1)/stacks);
                 
-                file << x4 << ' ' << y4 << ' ' << z4 << ' ';
-                file << p4n[0] << ' ' << p4n[1] << ' ' << p4n[2] << ' ';
-                file << (float)(i+1)/slices << ' ' << 1.0f - (float)j/stacks << '\n';
+                addVertex(vertices, x4, y4, z4,
+                          p4n[0], p4n[1], p4n[2],
+                          (float)(i+1)/slices, 1.0f - (float)j/stacks);
             }
         }
     }
     
-    file.close();
+    writeVerticesFull(filename, vertices);
 }
 
 // Generates points for a cone with normals and texture coordinates
@@ -545,10 +805,7 @@ void cone(float radius, float height, int slices, int stacks, const std::string&
         throw std::invalid_argument("Error: Radius, height, slices, and stacks must be positive.");
     }
 
-    std::ofstream file(filename);
-    if (!file.is_open()) {
-        throw std::runtime_error("Error: Unable to open file " + filename);
-    }
+    std::vector<VertexFull> vertices;
 
     float arch_alfa = 2 * M_PI / slices;
     float ratio = height / radius;
@@ -563,17 +820,17 @@ void cone(float radius, float height, int slices, int stacks, const std::string&
         z1 = radius * cos(arch_alfa * i);
         z2 = radius * cos(arch_alfa * (i+1));
      
-        file << x1 << ' ' << 0.0f << ' ' << z1 << ' ';
-        file << 0.0f << ' ' << -1.0f << ' ' << 0.0f << ' ';
-        file << 0.5f + 0.5f * sin(arch_alfa * i) << ' ' << 0.5f + 0.5f * cos(arch_alfa * i) << '\n';
+        addVertex(vertices, x1, 0.0f, z1,
+                  0.0f, -1.0f, 0.0f,
+                  0.5f + 0.5f * sin(arch_alfa * i), 0.5f + 0.5f * cos(arch_alfa * i));
 
-        file << 0.0f << ' ' << 0.0f << ' ' << 0.0f << ' ';
-        file << 0.0f << ' ' << -1.0f << ' ' << 0.0f << ' ';
-        file << 0.5f << ' ' << 0.5f << '\n';
+        addVertex(vertices, 0.0f, 0.0f, 0.0f,
+                  0.0f, -1.0f, 0.0f,
+                  0.5f, 0.5f);
 
-        file << x2 << ' ' << 0.0f << ' ' << z2 << ' ';
-        file << 0.0f << ' ' << -1.0f << ' ' << 0.0f << ' ';
-        file << 0.5f + 0.5f * sin(arch_alfa * (i+1)) << ' ' << 0.5f + 0.5f * cos(arch_alfa * (i+1)) << '\n';
+        addVertex(vertices, x2, 0.0f, z2,
+                  0.0f, -1.0f, 0.0f,
+                  0.5f + 0.5f * sin(arch_alfa * (i+1)), 0.5f + 0.5f * cos(arch_alfa * (i+1)));
     }
 
     // Sides of the cone
@@ -614,35 +871,35 @@ void cone(float radius, float height, int slices, int stacks, const std::string&
             normalize(p3n);
             normalize(p4n);
   
-            file << x1 << ' ' << y1 << ' ' << z1 << ' ';
-            file << p1n[0] << ' ' << p1n[1] << ' ' << p1n[2] << ' ';
-            file << (float)j/slices << ' ' << (float)i/stacks << '\n';
+            addVertex(vertices, x1, y1, z1,
+                      p1n[0], p1n[1], p1n[2],
+                      (float)j/slices, (float)i/stacks);
 
-            file << x2 << ' ' << y1 << ' ' << z2 << ' ';
-            file << p2n[0] << ' ' << p2n[1] << ' ' << p2n[2] << ' ';
-            file << (float)(j+1)/slices << ' ' << (float)i/stacks << '\n';
+            addVertex(vertices, x2, y1, z2,
+                      p2n[0], p2n[1], p2n[2],
+                      (float)(j+1)/slices, (float)i/stacks);
 
-            file << x4 << ' ' << y2 << ' ' << z4 << ' ';
-            file << p4n[0] << ' ' << p4n[1] << ' ' << p4n[2] << ' ';
-            file << (float)j/slices << ' ' << (float)(i+1)/stacks << '\n';
+            addVertex(vertices, x4, y2, z4,
+                      p4n[0], p4n[1], p4n[2],
+                      (float)j/slices, (float)(i+1)/stacks);
 
             if (i != stacks - 1) {
-                file << x4 << ' ' << y2 << ' ' << z4 << ' ';
-                file << p4n[0] << ' ' << p4n[1] << ' ' << p4n[2] << ' ';
-                file << (float)j/slices << ' ' << (float)(i+1)/stacks << '\n';
+                addVertex(vertices, x4, y2, z4,
+                          p4n[0], p4n[1], p4n[2],
+                          (float)j/slices, (float)(i+1)/stacks);
 
-                file << x2 << ' ' << y1 << ' ' << z2 << ' ';
-                file << p2n[0] << ' ' << p2n[1] << ' ' << p2n[2] << ' ';
-                file << (float)(j+1)/slices << ' ' << (float)i/stacks << '\n';
+                addVertex(vertices, x2, y1, z2,
+                          p2n[0], p2n[1], p2n[2],
+                          (float)(j+1)/slices, (float)i/stacks);
 
-                file << x3 << ' ' << y2 << ' ' << z3 << ' ';
-                file << p3n[0] << ' ' << p3n[1] << ' ' << p3n[2] << ' ';
-                file << (float)(j+1)/slices << ' ' << (float)(i+1)/stacks << '\n';
+                addVertex(vertices, x3, y2, z3,
+                          p3n[0], p3n[1], p3n[2],
+                          (float)(j+1)/slices, (float)(i+1)/stacks);
             }
         }
     }
 
-    file.close();
+    writeVerticesFull(filename, vertices);
 }
 
 // Generates points for a torus with normals and texture coordinates
@@ -651,10 +908,7 @@ void torus(float max_radius, float min_radius, int slices, int stacks, const std
         throw std::invalid_argument("Error: Radii, slices, and stacks must be positive.");
     }
 
-    std::ofstream file(filename);
-    if (!file.is_open()) {
-        throw std::runtime_error("Error: Unable to open file " + filename);
-    }
+    std::vector<VertexFull> vertices;
 
     float arch_alpha = (2 * M_PI) / stacks;
     float arch_beta = (2 * M_PI) / slices;
@@ -707,33 +961,33 @@ void torus(float max_radius, float min_radius, int slices, int stacks, const std
             normalize(p3n);
             normalize(p4n);
 
-            file << x1 << ' ' << y1 << ' ' << z1 << ' ';
-            file << p1n[0] << ' ' << p1n[1] << ' ' << p1n[2] << ' ';
-            file << (float)i/stacks << ' ' << (float)j/slices << '\n';
+            addVertex(vertices, x1, y1, z1,
+                      p1n[0], p1n[1], p1n[2],
+                      (float)i/stacks, (float)j/slices);
 
-            file << x2 << ' ' << y2 << ' ' << z2 << ' ';
-            file << p2n[0] << ' ' << p2n[1] << ' ' << p2n[2] << ' ';
-            file << (float)(i+1)/stacks << ' ' << (float)j/slices << '\n';
+            addVertex(vertices, x2, y2, z2,
+                      p2n[0], p2n[1], p2n[2],
+                      (float)(i+1)/stacks, (float)j/slices);
 
-            file << x4 << ' ' << y4 << ' ' << z4 << ' ';
-            file << p4n[0] << ' ' << p4n[1] << ' ' << p4n[2] << ' ';
-            file << (float)i/stacks << ' ' << (float)(j+1)/slices << '\n';
+            addVertex(vertices, x4, y4, z4,
+                      p4n[0], p4n[1], p4n[2],
+                      (float)i/stacks, (float)(j+1)/slices);
 
-            file << x2 << ' ' << y2 << ' ' << z2 << ' ';
-            file << p2n[0] << ' ' << p2n[1] << ' ' << p2n[2] << ' ';
-            file << (float)(i+1)/stacks << ' ' << (float)j/slices << '\n';
+            addVertex(vertices, x2, y2, z2,
+                      p2n[0], p2n[1], p2n[2],
+                      (float)(i+1)/stacks, (float)j/slices);
 
-            file << x3 << ' ' << y3 << ' ' << z3 << ' ';
-            file << p3n[0] << ' ' << p3n[1] << ' ' << p3n[2] << ' ';
-            file << (float)(i+1)/stacks << ' ' << (float)(j+1)/slices << '\n';
+            addVertex(vertices, x3, y3, z3,
+                      p3n[0], p3n[1], p3n[2],
+                      (float)(i+1)/stacks, (float)(j+1)/slices);
 
-            file << x4 << ' ' << y4 << ' ' << z4 << ' ';
-            file << p4n[0] << ' ' << p4n[1] << ' ' << p4n[2] << ' ';
-            file << (float)i/stacks << ' ' << (float)(j+1)/slices << '\n';
+            addVertex(vertices, x4, y4, z4,
+                      p4n[0], p4n[1], p4n[2],
+                      (float)i/stacks, (float)(j+1)/slices);
         }
     }
     
-    file.close();
+    writeVerticesFull(filename, vertices);
 }
 
 // Bezier functions
@@ -785,9 +1039,8 @@ float derivV(float U, float V, float m[4][4]) {
     return r;
 }
 
-// Generate Bezier surface patch
-std::string surface(float mx[4][4], float my[4][4], float mz[4][4], int tesselation) {
-    std::stringstream buffer;
+// Generate Bezier surface patch, appending its triangles to vertices
+void surface(float mx[4][4], float my[4][4], float mz[4][4], int tesselation, std::vector<VertexFull>& vertices) {
     float x1, x2, x3, x4, y1, y2, y3, y4, z1, z2, z3, z4;
     float p1u[3], p2u[3], p3u[3], p4u[3], p1v[3], p2v[3], p3v[3], p4v[3], p1n[3], p2n[3], p3n[3], p4n[3]; 
     float tesselation_level = 1.0f / tesselation;
@@ -855,34 +1108,32 @@ std::string surface(float mx[4][4], float my[4][4], float mz[4][4], int tesselat
             normalize(p4n);
 
             // First triangle
-            buffer << x1 << ' ' << y1 << ' ' << z1 << ' ';
-            buffer << p1n[0] << ' ' << p1n[1] << ' ' << p1n[2] << ' ';
-            buffer << j << ' ' << i << '\n';
+            addVertex(vertices, x1, y1, z1,
+                      p1n[0], p1n[1], p1n[2],
+                      j, i);
 
-            buffer << x2 << ' ' << y2 << ' ' << z2 << ' ';
-            buffer << p2n[0] << ' ' << p2n[1] << ' ' << p2n[2] << ' ';
-            buffer << j << ' ' << i + tesselation_level << '\n';
+            addVertex(vertices, x2, y2, z2,
+                      p2n[0], p2n[1], p2n[2],
+                      j, i + tesselation_level);
 
-            buffer << x4 << ' ' << y4 << ' ' << z4 << ' ';
-            buffer << p4n[0] << ' ' << p4n[1] << ' ' << p4n[2] << ' ';
-            buffer << j + tesselation_level << ' ' << i << '\n';
+            addVertex(vertices, x4, y4, z4,
+                      p4n[0], p4n[1], p4n[2],
+                      j + tesselation_level, i);
 
             // Second triangle
-            buffer << x2 << ' ' << y2 << ' ' << z2 << ' ';
-            buffer << p2n[0] << ' ' << p2n[1] << ' ' << p2n[2] << ' ';
-            buffer << j << ' ' << i + tesselation_level << '\n';
+            addVertex(vertices, x2, y2, z2,
+                      p2n[0], p2n[1], p2n[2],
+                      j, i + tesselation_level);
 
-            buffer << x3 << ' ' << y3 << ' ' << z3 << ' ';
-            buffer << p3n[0] << ' ' << p3n[1] << ' ' << p3n[2] << ' ';
-            buffer << j + tesselation_level << ' ' << i + tesselation_level << '\n';
+            addVertex(vertices, x3, y3, z3,
+                      p3n[0], p3n[1], p3n[2],
+                      j + tesselation_level, i + tesselation_level);
 
-            buffer << x4 << ' ' << y4 << ' ' << z4 << ' ';
-            buffer << p4n[0] << ' ' << p4n[1] << ' ' << p4n[2] << ' ';
-            buffer << j + tesselation_level << ' ' << i << '\n';
+            addVertex(vertices, x4, y4, z4,
+                      p4n[0], p4n[1], p4n[2],
+                      j + tesselation_level, i);
         }
     }
-    
-    return buffer.str();
 }
 
 // Read patches file
@@ -942,11 +1193,7 @@ std::vector<std::vector<std::vector<float>>> readPatchesFile(const std::string&
 
 // Generate Bezier patches
 void bezier_patches(const std::string& patch, int tesselation, const std::string& filename) {
-    std::ofstream file(filename);
-    if (!file.is_open()) {
-        throw std::runtime_error("Error: Unable to open file " + filename);
-    }
-
+    std::vector<VertexFull> vertices;
     std::vector<std::vector<std::vector<float>>> patches = readPatchesFile(patch);
 
     float bezier[4][4] = {
@@ -986,10 +1233,10 @@ void bezier_patches(const std::string& patch, int tesselation, const std::string
         multMatrixMatrix(bezier, mz, aux);
         multMatrixMatrix(aux, bezier, mz);
 
-        file << surface(mx, my, mz, tesselation);
+        surface(mx, my, mz, tesselation, vertices);
     }
 
-    file.close();
+    writeVerticesFull(filename, vertices);
 }
 
 // Enhanced version of bezier using the correct function name
@@ -1,6 +1,7 @@
 #ifndef GENERATORAUX_H
 #define GENERATORAUX_H
 
+#include <cstdint>
 #include <string>
 #include <vector>
 
@@ -10,8 +11,98 @@ struct Vertex {
     float z;
 };
 
+// Structure for vertex with normal and texture coordinates
+struct VertexFull {
+    float x, y, z;         // Position
+    float nx, ny, nz;      // Normal
+    float u, v;            // Texture coordinates
+};
+
+// Triangle mesh over a table of unique vertices
+struct IndexedMesh {
+    std::vector<VertexFull> vertices;   // Unique vertices
+    std::vector<uint32_t> indices;      // 3 per triangle
+};
+
+// How writeVerticesFull writes meshes (set once from the command line)
+struct MeshOutputOptions {
+    bool indexed = false;   // Deduplicate vertices and write an index list (.3db only)
+    bool optimize = false;  // Reorder indexed meshes for the vertex cache (see meshOptimizer.h)
+    bool overdraw = false;  // Also sort triangle clusters to reduce overdraw
+    bool quantize = false;  // Write 16-byte quantized vertices (.3db only, see meshFormat.h)
+    int lodLevels = 1;      // Levels of detail written per primitive (.3db only)
+};
+
+void setMeshOutputOptions(const MeshOutputOptions& options);
+
+// Options in effect for every mesh written (the generator's only copy)
+const MeshOutputOptions& getMeshOutputOptions();
+
+// Checks if a filename ends with the given suffix
+bool endsWith(const std::string& str, const std::string& suffix);
+
+/**
+ * @brief Selects the level of detail the next mesh is written as
+ *
+ * Level 0 creates the output file; higher levels are appended to it, so a
+ * primitive generated once per level, finest first, forms a LOD chain
+ * (see meshFormat.h).
+ *
+ * @param level Level of the next writeVerticesFull call
+ */
+void setMeshOutputLevel(int level);
+
+/**
+ * @brief Builds an indexed mesh from a triangle list
+ *
+ * Vertices with bit-identical position, normal and texture coordinates are
+ * merged; the triangle order is kept.
+ *
+ * @param triangles Triangle list (3 vertices per triangle)
+ * @return The unique vertices and the index list
+ */
+IndexedMesh buildIndexedMesh(const std::vector<VertexFull>& triangles);
+
+/**
+ * @brief Reads a .3d or .3db file back into an indexed mesh
+ *
+ * Triangle lists (text files and unindexed .3db files) are indexed with
+ * buildIndexedMesh. Only the first level of a LOD chain is read.
+ *
+ * @param filename Path of the model file
+ * @return The mesh
+ * @throws std::runtime_error If the file cannot be read or is malformed
+ */
+IndexedMesh readIndexedMesh(const std::string& filename);
+
+/**
+ * @brief Writes a mesh in the binary .3db container (see meshFormat.h)
+ *
+ * Vertices are quantized when MeshOutputOptions::quantize is set. The mesh
+ * is appended to the file when writing a level above 0 (see setMeshOutputLevel).
+ *
+ * @param filename Path of the output file
+ * @param vertices Vertex table (a triangle list when indices is empty)
+ * @param indices Index list, 3 per triangle (empty for a triangle list)
+ */
+void writeVerticesBinary(const std::string& filename, const std::vector<VertexFull>& vertices,
+                         const std::vector<uint32_t>& indices);
+
 void writeVertices(const std::string& filename, const std::vector<Vertex>& vertices);
 
+/**
+ * @brief Writes a mesh with normals and texture coordinates
+ *
+ * Filenames ending in ".3db" are written in the binary container described
+ * in meshFormat.h (indexed if MeshOutputOptions::indexed is set, and then
+ * optimized if MeshOutputOptions::optimize is set); any other
+ * extension produces the text .3d format.
+ *
+ * @param filename Path of the output file
+ * @param vertices Triangle list (3 vertices per triangle)
+ */
+void writeVerticesFull(const std::string& filename, const std::vector<VertexFull>& vertices);
+
 void plane(float unit, int slices, const std::string& filename);
 
 void box(float unit, int slices, const std::string& filename);
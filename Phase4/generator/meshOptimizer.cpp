@@ -0,0 +1,347 @@
+/**
+ * @file meshOptimizer.cpp
+ * @brief Vertex cache, overdraw and vertex fetch optimization of indexed meshes
+ */
+
+#include "meshOptimizer.h"
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+
+namespace {
+
+// Cache size the Forsyth scores are tuned for (larger than any real cache,
+// so the order degrades gracefully on smaller ones)
+const int FORSYTH_CACHE_SIZE = 32;
+const float FORSYTH_CACHE_DECAY_POWER = 1.5f;
+const float FORSYTH_LAST_TRIANGLE_SCORE = 0.75f;
+const float FORSYTH_VALENCE_BOOST_SCALE = 2.0f;
+const float FORSYTH_VALENCE_BOOST_POWER = 0.5f;
+
+// Largest remaining triangle count with a precomputed valence score
+const unsigned FORSYTH_MAX_VALENCE = 32;
+
+const uint32_t NO_VERTEX = std::numeric_limits<uint32_t>::max();
+
+// Precomputed parts of the Forsyth vertex score
+struct ForsythScores {
+    float cache[FORSYTH_CACHE_SIZE];
+    float valence[FORSYTH_MAX_VALENCE + 1];
+
+    ForsythScores() {
+        for (int i = 0; i < FORSYTH_CACHE_SIZE; i++) {
+            if (i < 3) {
+                // The last triangle's vertices score the same whatever their order
+                cache[i] = FORSYTH_LAST_TRIANGLE_SCORE;
+            } else {
+                float scale = 1.0f - static_cast<float>(i - 3) / (FORSYTH_CACHE_SIZE - 3);
+                cache[i] = std::pow(scale, FORSYTH_CACHE_DECAY_POWER);
+            }
+        }
+        valence[0] = 0;
+        for (unsigned i = 1; i <= FORSYTH_MAX_VALENCE; i++) {
+            valence[i] = FORSYTH_VALENCE_BOOST_SCALE * std::pow(static_cast<float>(i), -FORSYTH_VALENCE_BOOST_POWER);
+        }
+    }
+
+    // Score of a vertex: recently used vertices and vertices with few
+    // triangles left (which would otherwise be stranded) score higher
+    float vertex(int cachePosition, unsigned remaining) const {
+        if (remaining == 0) return -1.0f;
+        float score = cachePosition >= 0 ? cache[cachePosition] : 0.0f;
+        return score + valence[std::min(remaining, FORSYTH_MAX_VALENCE)];
+    }
+};
+
+/**
+ * @brief Splits a cache-optimized index list into clusters
+ *
+ * A cluster starts wherever a triangle misses the cache on all three
+ * vertices, i.e. where the vertex cache order starts a new region anyway.
+ * Longer runs are also cut as soon as the run, drawn with a cold cache,
+ * would stay within threshold times the ACMR of the whole list, so
+ * reordering the clusters costs at most that much cache efficiency.
+ *
+ * @param indices Index list (3 per triangle)
+ * @param vertexCount Number of vertices the indices refer to
+ * @param threshold Allowed ACMR increase (1.05 = 5%)
+ * @return First triangle of each cluster
+ */
+std::vector<size_t> findClusters(const std::vector<uint32_t>& indices, size_t vertexCount, float threshold) {
+    float maxClusterAcmr = analyzeVertexCache(indices, vertexCount).acmr * threshold;
+
+    std::vector<size_t> clusters;
+    std::vector<size_t> cacheTime(vertexCount, 0);
+    size_t time = VERTEX_CACHE_SIZE + 1;
+    size_t triangleCount = indices.size() / 3;
+
+    size_t clusterStart = 0;
+    size_t clusterMisses = 0;
+    bool cut = true;
+    for (size_t t = 0; t < triangleCount; t++) {
+        if (cut) {
+            time += VERTEX_CACHE_SIZE + 1;  // Every vertex misses again
+            clusterStart = t;
+            clusterMisses = 0;
+            cut = false;
+        }
+
+        int misses = 0;
+        for (int k = 0; k < 3; k++) {
+            uint32_t v = indices[t * 3 + k];
+            if (time - cacheTime[v] > VERTEX_CACHE_SIZE) {
+                cacheTime[v] = time++;
+                misses++;
+            }
+        }
+        if (misses == 3 && t > clusterStart) {
+            // Hard boundary: this triangle starts the next cluster
+            clusters.push_back(clusterStart);
+            clusterStart = t;
+            clusterMisses = 0;
+        }
+        clusterMisses += misses;
+
+        if (clusterMisses <= maxClusterAcmr * (t - clusterStart + 1)) {
+            clusters.push_back(clusterStart);
+            cut = true;
+        }
+    }
+    if (!cut) clusters.push_back(clusterStart);
+    return clusters;
+}
+
+} // namespace
+
+VertexCacheStats analyzeVertexCache(const std::vector<uint32_t>& indices, size_t vertexCount,
+                                    unsigned cacheSize) {
+    VertexCacheStats stats;
+    size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0 || vertexCount == 0) return stats;
+
+    // FIFO cache: a vertex is cached while fewer than cacheSize misses
+    // happened after its own
+    std::vector<size_t> cacheTime(vertexCount, 0);
+    size_t time = cacheSize + 1;
+    size_t misses = 0;
+    for (uint32_t v : indices) {
+        if (time - cacheTime[v] > cacheSize) {
+            cacheTime[v] = time++;
+            misses++;
+        }
+    }
+
+    stats.acmr = static_cast<float>(misses) / triangleCount;
+    stats.atvr = static_cast<float>(misses) / vertexCount;
+    return stats;
+}
+
+void optimizeVertexCache(std::vector<uint32_t>& indices, size_t vertexCount) {
+    static const ForsythScores scores;
+    size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0) return;
+
+    // Triangles of each vertex (CSR layout); the first remaining[v] entries
+    // of a vertex's span are the triangles not emitted yet
+    std::vector<unsigned> remaining(vertexCount, 0);
+    for (uint32_t v : indices) remaining[v]++;
+    std::vector<size_t> firstTriangle(vertexCount + 1, 0);
+    for (size_t v = 0; v < vertexCount; v++) {
+        firstTriangle[v + 1] = firstTriangle[v] + remaining[v];
+    }
+    std::vector<uint32_t> vertexTriangles(indices.size());
+    {
+        std::vector<size_t> fill(firstTriangle.begin(), firstTriangle.end() - 1);
+        for (size_t t = 0; t < triangleCount; t++) {
+            for (int k = 0; k < 3; k++) {
+                uint32_t v = indices[t * 3 + k];
+                vertexTriangles[fill[v]++] = static_cast<uint32_t>(t);
+            }
+        }
+    }
+
+    std::vector<int> cachePosition(vertexCount, -1);
+    std::vector<float> vertexScore(vertexCount);
+    for (size_t v = 0; v < vertexCount; v++) {
+        vertexScore[v] = scores.vertex(-1, remaining[v]);
+    }
+    std::vector<float> triangleScore(triangleCount);
+    std::vector<bool> emitted(triangleCount, false);
+    for (size_t t = 0; t < triangleCount; t++) {
+        triangleScore[t] = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] +
+                           vertexScore[indices[t * 3 + 2]];
+    }
+
+    std::vector<uint32_t> cache, nextCache;
+    cache.reserve(FORSYTH_CACHE_SIZE + 3);
+    nextCache.reserve(FORSYTH_CACHE_SIZE + 3);
+    std::vector<uint32_t> result;
+    result.reserve(indices.size());
+
+    size_t best = static_cast<size_t>(std::max_element(triangleScore.begin(), triangleScore.end()) -
+                                      triangleScore.begin());
+    size_t cursor = 0;   // Every triangle before it has been emitted
+
+    while (result.size() < indices.size()) {
+        if (best == triangleCount) {
+            // Nothing in the cache has triangles left: continue with the
+            // next triangle in the original order
+            while (emitted[cursor]) cursor++;
+            best = cursor;
+        }
+
+        const uint32_t* triangle = &indices[best * 3];
+        result.insert(result.end(), triangle, triangle + 3);
+        emitted[best] = true;
+
+        // Drop the triangle from its vertices' remaining lists
+        for (int k = 0; k < 3; k++) {
+            uint32_t v = triangle[k];
+            uint32_t* begin = &vertexTriangles[firstTriangle[v]];
+            uint32_t* end = begin + remaining[v];
+            uint32_t* found = std::find(begin, end, static_cast<uint32_t>(best));
+            std::swap(*found, *(end - 1));
+            remaining[v]--;
+        }
+
+        // The triangle's vertices move to the front of the LRU cache
+        nextCache.clear();
+        for (int k = 0; k < 3; k++) {
+            if (std::find(nextCache.begin(), nextCache.end(), triangle[k]) == nextCache.end()) {
+                nextCache.push_back(triangle[k]);
+            }
+        }
+        for (uint32_t v : cache) {
+            if (v != triangle[0] && v != triangle[1] && v != triangle[2]) nextCache.push_back(v);
+        }
+        for (uint32_t v : cache) cachePosition[v] = -1;
+        for (size_t i = 0; i < nextCache.size(); i++) {
+            cachePosition[nextCache[i]] = i < FORSYTH_CACHE_SIZE ? static_cast<int>(i) : -1;
+        }
+
+        // Rescore every vertex whose cache position or valence changed
+        // (including the ones just evicted) and their triangles
+        best = triangleCount;
+        float bestScore = -std::numeric_limits<float>::max();
+        for (size_t i = 0; i < nextCache.size(); i++) {
+            uint32_t v = nextCache[i];
+            float score = scores.vertex(cachePosition[v], remaining[v]);
+            float delta = score - vertexScore[v];
+            vertexScore[v] = score;
+
+            const uint32_t* adjacent = &vertexTriangles[firstTriangle[v]];
+            for (unsigned j = 0; j < remaining[v]; j++) {
+                uint32_t t = adjacent[j];
+                triangleScore[t] += delta;
+                if (i < FORSYTH_CACHE_SIZE && triangleScore[t] > bestScore) {
+                    bestScore = triangleScore[t];
+                    best = t;
+                }
+            }
+        }
+
+        if (nextCache.size() > FORSYTH_CACHE_SIZE) nextCache.resize(FORSYTH_CACHE_SIZE);
+        cache.swap(nextCache);
+    }
+
+    indices.swap(result);
+}
+
+void optimizeOverdraw(IndexedMesh& mesh, float threshold) {
+    const std::vector<VertexFull>& vertices = mesh.vertices;
+    std::vector<uint32_t>& indices = mesh.indices;
+    size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0) return;
+
+    std::vector<size_t> clusters = findClusters(indices, vertices.size(), threshold);
+    clusters.push_back(triangleCount);
+    size_t clusterCount = clusters.size() - 1;
+
+    float meshCenter[3] = {0, 0, 0};
+    for (const VertexFull& v : vertices) {
+        meshCenter[0] += v.x;
+        meshCenter[1] += v.y;
+        meshCenter[2] += v.z;
+    }
+    for (int k = 0; k < 3; k++) meshCenter[k] /= vertices.size();
+
+    // A cluster whose area-weighted normal points away from the mesh centre
+    // is on the outside and likely to occlude the others: draw it first
+    std::vector<float> sortKey(clusterCount);
+    for (size_t c = 0; c < clusterCount; c++) {
+        float center[3] = {0, 0, 0};
+        float normal[3] = {0, 0, 0};
+        float totalArea = 0;
+        for (size_t t = clusters[c]; t < clusters[c + 1]; t++) {
+            const VertexFull& a = vertices[indices[t * 3]];
+            const VertexFull& b = vertices[indices[t * 3 + 1]];
+            const VertexFull& d = vertices[indices[t * 3 + 2]];
+            float e1[3] = {b.x - a.x, b.y - a.y, b.z - a.z};
+            float e2[3] = {d.x - a.x, d.y - a.y, d.z - a.z};
+            float n[3] = {e1[1] * e2[2] - e1[2] * e2[1],
+                          e1[2] * e2[0] - e1[0] * e2[2],
+                          e1[0] * e2[1] - e1[1] * e2[0]};
+            float area = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+            center[0] += (a.x + b.x + d.x) / 3 * area;
+            center[1] += (a.y + b.y + d.y) / 3 * area;
+            center[2] += (a.z + b.z + d.z) / 3 * area;
+            for (int k = 0; k < 3; k++) normal[k] += n[k];
+            totalArea += area;
+        }
+
+        float normalLength = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+        if (totalArea <= 0 || normalLength <= 0) {
+            sortKey[c] = 0;
+            continue;
+        }
+        float key = 0;
+        for (int k = 0; k < 3; k++) {
+            key += (center[k] / totalArea - meshCenter[k]) * normal[k] / normalLength;
+        }
+        sortKey[c] = key;
+    }
+
+    std::vector<size_t> order(clusterCount);
+    for (size_t c = 0; c < clusterCount; c++) order[c] = c;
+    std::stable_sort(order.begin(), order.end(),
+                     [&sortKey](size_t a, size_t b) { return sortKey[a] > sortKey[b]; });
+
+    std::vector<uint32_t> result;
+    result.reserve(indices.size());
+    for (size_t c : order) {
+        result.insert(result.end(), indices.begin() + clusters[c] * 3, indices.begin() + clusters[c + 1] * 3);
+    }
+    indices.swap(result);
+}
+
+void optimizeVertexFetch(IndexedMesh& mesh) {
+    std::vector<uint32_t> remap(mesh.vertices.size(), NO_VERTEX);
+    std::vector<VertexFull> vertices;
+    vertices.reserve(mesh.vertices.size());
+
+    for (uint32_t& index : mesh.indices) {
+        if (remap[index] == NO_VERTEX) {
+            remap[index] = static_cast<uint32_t>(vertices.size());
+            vertices.push_back(mesh.vertices[index]);
+        }
+        index = remap[index];
+    }
+    mesh.vertices.swap(vertices);
+}
+
+void optimizeMesh(IndexedMesh& mesh, bool overdraw) {
+    VertexCacheStats before = analyzeVertexCache(mesh.indices, mesh.vertices.size());
+
+    optimizeVertexCache(mesh.indices, mesh.vertices.size());
+    if (overdraw) optimizeOverdraw(mesh);
+    optimizeVertexFetch(mesh);
+
+    VertexCacheStats after = analyzeVertexCache(mesh.indices, mesh.vertices.size());
+    std::cout << std::fixed << std::setprecision(3)
+              << "Vertex cache (" << VERTEX_CACHE_SIZE << " entries): ACMR " << before.acmr << " -> " << after.acmr
+              << ", ATVR " << before.atvr << " -> " << after.atvr << std::endl;
+    std::cout.unsetf(std::ios::floatfield);
+    std::cout << std::setprecision(6);
+}
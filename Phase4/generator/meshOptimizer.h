@@ -0,0 +1,83 @@
+#ifndef MESH_OPTIMIZER_H
+#define MESH_OPTIMIZER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "generatorAux.h"
+
+/**
+ * @file meshOptimizer.h
+ * @brief Triangle and vertex reordering for indexed meshes
+ *
+ * The nested slice/stack loops of the primitives emit triangles in strips
+ * that revisit a vertex long after it left the GPU's post-transform cache.
+ * These passes reorder an IndexedMesh without changing its geometry:
+ *
+ * 1. optimizeVertexCache: triangle order for post-transform cache hits
+ *    (Forsyth's linear-speed algorithm)
+ * 2. optimizeOverdraw: splits the result into clusters and draws the
+ *    outward-facing clusters first, so more fragments fail the depth test
+ * 3. optimizeVertexFetch: renumbers vertices in first-use order so vertex
+ *    fetches walk the buffers linearly
+ */
+
+// Post-transform cache size assumed by the statistics
+const unsigned VERTEX_CACHE_SIZE = 16;
+
+// Vertex cache statistics of an index list
+struct VertexCacheStats {
+    float acmr = 0;   // Average cache miss ratio: transformed vertices per triangle (0.5 - 3)
+    float atvr = 0;   // Average transform to vertex ratio: transformed vertices per unique vertex (>= 1)
+};
+
+/**
+ * @brief Simulates a FIFO post-transform cache over an index list
+ *
+ * @param indices Index list (3 per triangle)
+ * @param vertexCount Number of vertices the indices refer to
+ * @param cacheSize Number of entries of the simulated cache
+ * @return ACMR and ATVR of the index list
+ */
+VertexCacheStats analyzeVertexCache(const std::vector<uint32_t>& indices, size_t vertexCount,
+                                    unsigned cacheSize = VERTEX_CACHE_SIZE);
+
+/**
+ * @brief Reorders triangles to maximize post-transform cache hits
+ *
+ * @param indices Index list (3 per triangle), reordered in place
+ * @param vertexCount Number of vertices the indices refer to
+ */
+void optimizeVertexCache(std::vector<uint32_t>& indices, size_t vertexCount);
+
+/**
+ * @brief Reorders clusters of triangles to reduce overdraw
+ *
+ * Must run after optimizeVertexCache: clusters are cut where that order
+ * starts over with three cache misses, or where a run is already as cache
+ * efficient as the threshold allows, so sorting them keeps most of the
+ * cache behaviour.
+ *
+ * @param mesh Mesh whose index list is reordered in place
+ * @param threshold Allowed ACMR increase over the cache-optimized order (1.05 = 5%)
+ */
+void optimizeOverdraw(IndexedMesh& mesh, float threshold = 1.05f);
+
+/**
+ * @brief Renumbers vertices in the order the index list first uses them
+ *
+ * Vertices no index refers to are dropped.
+ *
+ * @param mesh Mesh whose vertices and indices are rewritten
+ */
+void optimizeVertexFetch(IndexedMesh& mesh);
+
+/**
+ * @brief Runs all passes and prints ACMR/ATVR before and after
+ *
+ * @param mesh Mesh to optimize in place
+ * @param overdraw Also run optimizeOverdraw
+ */
+void optimizeMesh(IndexedMesh& mesh, bool overdraw);
+
+#endif // MESH_OPTIMIZER_H